@@ -21,6 +21,7 @@
 #include <unistd.h>
 #include <mpi.h>
 #include <mpi-ext.h>
+#include "../tutorial/ftfailed.h"
 #include <signal.h>
 
 int main( int argc, char* argv[] ) {
@@ -45,8 +46,7 @@ int main( int argc, char* argv[] ) {
     rc = MPI_Sendrecv( &sb, 1, MPI_INT, (rank+1)%np, 1,
                        &rb, 1, MPI_INT, (rank+np-1)%np, 1,
                        commw, &st );
-    MPIX_Comm_failure_ack( commw );
-    MPIX_Comm_failure_get_acked( commw, &gf );
+    ftf_ack_failed( commw, &gf );
     MPI_Group_size( gf, &gs );
     if( rc != MPI_SUCCESS ) {
         kf++;
@@ -65,7 +65,7 @@ int main( int argc, char* argv[] ) {
     } else {
         printf( "Rank %02d: TEST PASSED  The group of failed processes is of size %d / %d.\n", rank, gs, kf );
     }
-    MPI_Group_free( &gf );
+    ftf_group_free( &gf );
 
     sleep(1);
     if( 0 == rank ) printf( "...\n");
@@ -85,8 +85,7 @@ int main( int argc, char* argv[] ) {
         MPI_Abort( MPI_COMM_WORLD, -3 );
     }
     /* Inspect the failure set */
-    MPIX_Comm_failure_ack( commw );
-    MPIX_Comm_failure_get_acked( commw, &gf );
+    ftf_ack_failed( commw, &gf );
     if( gf == MPI_GROUP_EMPTY ) {
         fprintf( stderr, "Rank %02d: TEST FAILED! The group of failed processes is empty. At least %d failure should have been reported though\n", rank, kf );
         sleep(1);
@@ -99,7 +98,7 @@ int main( int argc, char* argv[] ) {
         MPI_Abort( MPI_COMM_WORLD, -5 );
     }
     printf( "Rank %02d: TEST PASSED  The group of failed processes is of size %d / %d.\n", rank, gs, kf );
-    MPI_Group_free( &gf );
+    ftf_group_free( &gf );
 
     MPI_Finalize();
 }
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2014-2017 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ *
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Latency of the consensus operations of tutorial/ftconsensus.h, against
+ * a raw MPIX_Comm_agree and an MPI_Allreduce (which is not reliable
+ * under failures): min of an int with the reduction fast path (REDUCE)
+ * and with agreements only (AGREE), union of a set of np elements,
+ * leader election. With -f, that rank dies, and the time of the first
+ * consensus after its failure (agreements only) is reported, as well as
+ * the latencies once the failure is known.
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <signal.h>
+#include <math.h>
+
+#include "../tutorial/ftconsensus.h"
+
+/** Knuth algorithm for online numerically stable computation of variance */
+typedef struct {
+    int     n;
+    double  mean;
+    double  m2;
+} stat_t;
+
+static inline double stat_get_mean(stat_t *s) {
+    return s->mean;
+}
+
+static inline double stat_get_stdev(stat_t *s) {
+    if( s->n > 1 )
+        return sqrt(s->m2/(double)(s->n-1));
+    return NAN;
+}
+
+static inline void stat_record(stat_t *s, double v) {
+    double delta;
+    s->n++;
+    delta = v - s->mean;
+    s->mean += delta / (double)s->n;
+    s->m2 += delta * (v - s->mean);
+}
+
+static inline void stat_init(stat_t *s) {
+    s->n    = 0;
+    s->mean = 0.0;
+    s->m2   = 0.0;
+}
+
+#define OP_AGREE      0
+#define OP_ALLREDUCE  1
+#define OP_MIN_REDUCE 2
+#define OP_MIN_AGREE  3
+#define OP_UNION      4
+#define OP_ELECT      5
+#define NB_OPS        6
+
+static const char* op_names[NB_OPS] = {
+    "RAW_AGREE", "RAW_ALLREDUCE", "MIN_REDUCE", "MIN_AGREE", "UNION", "ELECT"
+};
+
+static int nwords;
+static unsigned* set;
+
+static int do_op(MPI_Comm comm, int op)
+{
+    int v = rand() % 1000, i, rank;
+
+    MPI_Comm_rank(comm, &rank);
+
+    switch(op) {
+    case OP_AGREE:
+        return MPIX_Comm_agree(comm, &v);
+    case OP_ALLREDUCE:
+        return MPI_Allreduce(MPI_IN_PLACE, &v, 1, MPI_INT, MPI_MIN, comm);
+    case OP_MIN_REDUCE:
+        ftc_set_reduce(1);
+        return ftc_agree_min(comm, &v);
+    case OP_MIN_AGREE:
+        ftc_set_reduce(0);
+        return ftc_agree_min(comm, &v);
+    case OP_UNION:
+        for(i = 0; i < nwords; i++) set[i] = 0;
+        set[rank/32] = 1u << (rank%32);
+        return ftc_agree_union(comm, set, nwords);
+    case OP_ELECT:
+        return ftc_elect(comm, rank % 2, &v);
+    }
+    return MPI_SUCCESS;
+}
+
+/* the operations on comm, synchronized and reported on scomm */
+static void measure(MPI_Comm comm, MPI_Comm scomm, const char* when, int nb)
+{
+    stat_t s;
+    double start, mean, max;
+    int op, i, rank, size;
+
+    MPI_Comm_rank(scomm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    for(op = 0; op < NB_OPS; op++) {
+        /* the raw allreduce fails once a process is dead */
+        if( OP_ALLREDUCE == op && 'A' == when[0] ) continue;
+        stat_init(&s);
+        MPI_Barrier(scomm);
+        do_op(comm, op);
+        for(i = 0; i < nb; i++) {
+            start = MPI_Wtime();
+            do_op(comm, op);
+            stat_record(&s, MPI_Wtime() - start);
+        }
+        mean = stat_get_mean(&s);
+        MPI_Reduce(&mean, &max, 1, MPI_DOUBLE, MPI_MAX, 0, scomm);
+        if( 0 == rank )
+            printf("%s %s %g s (stdev %g ) per operation, max over %d ranks (average over %d operations)\n",
+                   when, op_names[op], max, stat_get_stdev(&s), size, nb);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, size, c, nb = 100, victim = -1, v, rc;
+    double start;
+    MPI_Comm scomm;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    while(1) {
+        static struct option long_options[] = {
+            { "number",       1, 0, 'n' },
+            { "fault",        1, 0, 'f' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "n:f:", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 'n':
+            nb = atoi(optarg);
+            break;
+        case 'f':
+            victim = atoi(optarg);
+            break;
+        }
+    }
+
+    nwords = (size + 31) / 32;
+    set = (unsigned*)calloc(nwords, sizeof(unsigned));
+    srand(rank + 1);
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+
+    measure(MPI_COMM_WORLD, MPI_COMM_WORLD, "BEFORE_FAILURE", nb);
+
+    if( 0 <= victim && victim < size ) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        if( rank == victim ) {
+            raise(SIGKILL); do { pause(); } while(1);
+        }
+        /* the first consensus has to see the failure */
+        v = rank;
+        ftc_set_reduce(0);
+        start = MPI_Wtime();
+        rc = ftc_agree_min(MPI_COMM_WORLD, &v);
+        start = MPI_Wtime() - start;
+        printf("FIRST_CONSENSUS_AFTER_FAILURE %g s on rank %d, decided %d (rc %d)\n",
+               start, rank, v, rc);
+
+        /* on the communicator with the dead process, and on the
+         * survivors only */
+        MPIX_Comm_shrink(MPI_COMM_WORLD, &scomm);
+        measure(MPI_COMM_WORLD, scomm, "AFTER_FAILURE", nb);
+        measure(scomm, scomm, "SHRUNK", nb);
+        MPI_Comm_free(&scomm);
+    }
+
+    free(set);
+    MPI_Finalize();
+
+    return 0;
+}
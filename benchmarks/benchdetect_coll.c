@@ -0,0 +1,200 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * How fast a failure is reported by each collective, blocking and
+ * nonblocking, with small (-s) and large (-S) messages: Bcast, Reduce,
+ * Allreduce, Allgather, Alltoall, Gather, Scatter and Scan (-c runs only
+ * one of them, -b only blocking, -n only nonblocking). For each case,
+ * the last rank dies and the others call the collective until it fails
+ * (a collective may complete at some ranks). The first to see the error
+ * revokes the communicator, so that all get out; we report when each
+ * rank got its error, and whether it was the failure itself or the
+ * revocation. They then shrink, and the time to the first successful
+ * collective on the new communicator is reported, from the error. Each
+ * case costs one process: with fewer ranks than cases, the last
+ * cases are not run.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#define NB_COLLS 8
+
+static const char* coll_names[NB_COLLS] = {
+    "Bcast", "Reduce", "Allreduce", "Allgather", "Alltoall", "Gather", "Scatter", "Scan"
+};
+
+static char *sbuf, *rbuf;
+
+/* count bytes per process */
+static int coll(MPI_Comm comm, int c, int nb, int count)
+{
+    MPI_Request req;
+    int rc, n = count / sizeof(int);
+
+    switch(c) {
+    case 0:
+        rc = nb? MPI_Ibcast(sbuf, count, MPI_BYTE, 0, comm, &req):
+                 MPI_Bcast(sbuf, count, MPI_BYTE, 0, comm);
+        break;
+    case 1:
+        rc = nb? MPI_Ireduce(sbuf, rbuf, n, MPI_INT, MPI_SUM, 0, comm, &req):
+                 MPI_Reduce(sbuf, rbuf, n, MPI_INT, MPI_SUM, 0, comm);
+        break;
+    case 2:
+        rc = nb? MPI_Iallreduce(sbuf, rbuf, n, MPI_INT, MPI_SUM, comm, &req):
+                 MPI_Allreduce(sbuf, rbuf, n, MPI_INT, MPI_SUM, comm);
+        break;
+    case 3:
+        rc = nb? MPI_Iallgather(sbuf, count, MPI_BYTE, rbuf, count, MPI_BYTE, comm, &req):
+                 MPI_Allgather(sbuf, count, MPI_BYTE, rbuf, count, MPI_BYTE, comm);
+        break;
+    case 4:
+        rc = nb? MPI_Ialltoall(sbuf, count, MPI_BYTE, rbuf, count, MPI_BYTE, comm, &req):
+                 MPI_Alltoall(sbuf, count, MPI_BYTE, rbuf, count, MPI_BYTE, comm);
+        break;
+    case 5:
+        rc = nb? MPI_Igather(sbuf, count, MPI_BYTE, rbuf, count, MPI_BYTE, 0, comm, &req):
+                 MPI_Gather(sbuf, count, MPI_BYTE, rbuf, count, MPI_BYTE, 0, comm);
+        break;
+    case 6:
+        rc = nb? MPI_Iscatter(sbuf, count, MPI_BYTE, rbuf, count, MPI_BYTE, 0, comm, &req):
+                 MPI_Scatter(sbuf, count, MPI_BYTE, rbuf, count, MPI_BYTE, 0, comm);
+        break;
+    default:
+        rc = nb? MPI_Iscan(sbuf, rbuf, n, MPI_INT, MPI_SUM, comm, &req):
+                 MPI_Scan(sbuf, rbuf, n, MPI_INT, MPI_SUM, comm);
+        break;
+    }
+    if( nb && MPI_SUCCESS == rc )
+        rc = MPI_Wait(&req, MPI_STATUS_IGNORE);
+    return rc;
+}
+
+int main( int argc, char* argv[] ) {
+    MPI_Comm fcomm, ncomm;
+    int np, rank, size, c, nb, s, i, rc, eclass, ncalls, direct;
+    int only = -1, fromnb = 0, tonb = 1, sizes[2] = { 8, 1<<20 };
+    double start, t[4], mint[4], maxt[4];
+    int cnt[2], sum[2];
+
+    MPI_Init( &argc, &argv );
+    MPI_Comm_size( MPI_COMM_WORLD, &np );
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+    while(1) {
+        static struct option long_options[] = {
+            { "collective",   1, 0, 'c' },
+            { "small",        1, 0, 's' },
+            { "large",        1, 0, 'S' },
+            { "blocking",     0, 0, 'b' },
+            { "nonblocking",  0, 0, 'n' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "c:s:S:bn", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 'c':
+            for(only = NB_COLLS - 1; only > 0 && strcasecmp(optarg, coll_names[only]); only--);
+            break;
+        case 's':
+            sizes[0] = atoi(optarg);
+            break;
+        case 'S':
+            sizes[1] = atoi(optarg);
+            break;
+        case 'b':
+            tonb = 0;
+            break;
+        case 'n':
+            fromnb = 1;
+            break;
+        }
+    }
+
+    sbuf = (char*)calloc((size_t)sizes[1] * np, 1);
+    rbuf = (char*)calloc((size_t)sizes[1] * np, 1);
+
+    MPI_Comm_dup( MPI_COMM_WORLD, &fcomm );
+    MPI_Comm_set_errhandler( fcomm, MPI_ERRORS_RETURN );
+
+    if( 0 == rank ) printf(
+        "## Collective      Bytes # No fault      # First error (min .. max)    # by failure # Shrink        # First success # Calls\n");
+
+    for(c = (only < 0)? 0: only; c < ((only < 0)? NB_COLLS: only + 1); c++) {
+        for(nb = fromnb; nb <= tonb; nb++) {
+            for(s = 0; s < 2; s++) {
+                MPI_Comm_size( fcomm, &size );
+                MPI_Comm_rank( fcomm, &rank );
+                if( size < 2 ) goto done;
+
+                /* without failure */
+                coll(fcomm, c, nb, sizes[s]);
+                MPI_Barrier(fcomm);
+                start = MPI_Wtime();
+                coll(fcomm, c, nb, sizes[s]);
+                t[0] = MPI_Wtime() - start;
+                MPI_Barrier(fcomm);
+
+                /* the victim is the last rank */
+                if( rank == size - 1 ) {
+                    raise(SIGKILL); do { pause(); } while(1);
+                }
+                start = MPI_Wtime();
+                ncalls = 0;
+                do {
+                    rc = coll(fcomm, c, nb, sizes[s]);
+                    ncalls++;
+                } while( MPI_SUCCESS == rc );
+                t[1] = MPI_Wtime() - start;
+                MPI_Error_class(rc, &eclass);
+                direct = (MPIX_ERR_REVOKED != eclass);
+                MPIX_Comm_revoke(fcomm);
+
+                start = MPI_Wtime();
+                MPIX_Comm_shrink(fcomm, &ncomm);
+                t[2] = MPI_Wtime() - start;
+                MPI_Comm_set_errhandler( ncomm, MPI_ERRORS_RETURN );
+                for(i = 0; MPI_SUCCESS != coll(ncomm, c, nb, sizes[s]) && i < 10; i++);
+                t[3] = MPI_Wtime() - start;
+                MPI_Comm_free(&fcomm);
+                fcomm = ncomm;
+
+                cnt[0] = direct; cnt[1] = ncalls;
+                MPI_Reduce(t, mint, 4, MPI_DOUBLE, MPI_MIN, 0, fcomm);
+                MPI_Reduce(t, maxt, 4, MPI_DOUBLE, MPI_MAX, 0, fcomm);
+                MPI_Reduce(cnt, sum, 2, MPI_INT, MPI_SUM, 0, fcomm);
+                if( 0 == rank )
+                    printf("%-1s%-10s %10d # %13.5e # %13.5e .. %13.5e # %4d / %-4d # %13.5e # %13.5e # %5.2f\n",
+                           nb? "I": "", coll_names[c], sizes[s], maxt[0], mint[1], maxt[1],
+                           sum[0], size - 1, maxt[2], maxt[3], sum[1] / (double)(size - 1));
+            }
+        }
+    }
+
+  done:
+    MPI_Comm_free( &fcomm );
+    free(sbuf); free(rbuf);
+
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
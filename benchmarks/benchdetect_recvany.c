@@ -20,6 +20,8 @@
 #include <mpi.h>
 #include <mpi-ext.h>
 
+#include "../tutorial/ftfailed.h"
+
 void print_timings( MPI_Comm scomm, double tff, double twf );
 int rank, verbose=0; /* makes this global (for printfs) */
 
@@ -135,23 +137,17 @@ do {
      * impossible for any rank to complete succesfully! */
     if( rc != MPI_ERR_PROC_FAILED ) MPI_Abort( MPI_COMM_WORLD, rc );
 
-    MPIX_Comm_failure_ack(fcomm);
-    MPIX_Comm_failure_get_acked(fcomm, &fgrp[nwup]);
+    ftf_ack_failed(fcomm, &fgrp[nwup]);
     MPI_Group_size(fgrp[nwup], &nf);
     nwup++;
 } while( nf < mf );
 
     char str[4096];
     /* print results */
-    MPI_Group group_c;
-    MPI_Comm_group(fcomm, &group_c);
-    int* ranks_gc = (int*)malloc(mf * sizeof(int));
-    int* ranks_gf = (int*)malloc(mf * sizeof(int));
-    for(i = 0; i < mf; i++) ranks_gf[i] = i;
+    int* ranks_gc = (int*)malloc(np * sizeof(int));
     for(i = 0; i < nwup; i++ ) {
         MPI_Group_size(fgrp[i], &nf);
-        MPI_Group_translate_ranks(fgrp[i], nf, ranks_gf,
-                                  group_c, ranks_gc);
+        ftf_translate(fcomm, fgrp[i], nf, ranks_gc);
         int ii;
         int len;
         len = snprintf(str, 4096, "Rank %04d: during wake up %d I observed %d faults, duration %.6e (s) at date %.9f { ", rank, i, nf, twup[i]-start, twup[i]);
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2014-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ *
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Cost of the calls an error handler makes on the failed set of a
+ * communicator, as the number of failures grows: 0, then 1, 2, 4... up to
+ * -m (np/2 by default) of the highest ranks die. At each step, once all
+ * the survivors know of the failures, on MPI_COMM_WORLD:
+ *  - GET: the failed group (ftf_get_failed);
+ *  - ACK: acknowledge the failures and get them (ftf_ack_failed);
+ *  - TRANSLATE: their ranks in the communicator (ftf_translate);
+ *  - TRANSLATE_MALLOC: the same, allocating the rank arrays and getting
+ *    the group of the communicator each time;
+ *  - IS_REVOKED: ftf_is_revoked;
+ *  - CACHE_UPDATE: ftf_cache_update, with no new failure since the
+ *    previous step (the new ones are translated in the first call);
+ *  - IS_FAILED: ftf_is_failed, for all the ranks;
+ *  - LEGACY_ACK: MPIX_Comm_failure_ack / MPIX_Comm_failure_get_acked,
+ *    when the build uses MPIX_Comm_get_failed, for comparison.
+ * The API is chosen at build time, see tutorial/ftfailed.h: build with
+ * -DFTF_GET_FAILED=0 to measure the legacy one alone.
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <signal.h>
+#include <math.h>
+
+#include "../tutorial/ftfailed.h"
+
+/** Knuth algorithm for online numerically stable computation of variance */
+typedef struct {
+    int     n;
+    double  mean;
+    double  m2;
+} stat_t;
+
+static inline double stat_get_mean(stat_t *s) {
+    return s->mean;
+}
+
+static inline double stat_get_stdev(stat_t *s) {
+    if( s->n > 1 )
+        return sqrt(s->m2/(double)(s->n-1));
+    return NAN;
+}
+
+static inline void stat_record(stat_t *s, double v) {
+    double delta;
+    s->n++;
+    delta = v - s->mean;
+    s->mean += delta / (double)s->n;
+    s->m2 += delta * (v - s->mean);
+}
+
+static inline void stat_init(stat_t *s) {
+    s->n    = 0;
+    s->mean = 0.0;
+    s->m2   = 0.0;
+}
+
+#define OP_GET              0
+#define OP_ACK              1
+#define OP_TRANSLATE        2
+#define OP_TRANSLATE_MALLOC 3
+#define OP_IS_REVOKED       4
+#define OP_CACHE_UPDATE     5
+#define OP_IS_FAILED        6
+#define OP_LEGACY_ACK       7
+#define NB_OPS              8
+
+static const char* op_names[NB_OPS] = {
+    "GET", "ACK", "TRANSLATE", "TRANSLATE_MALLOC", "IS_REVOKED",
+    "CACHE_UPDATE", "IS_FAILED", "LEGACY_ACK"
+};
+
+static int* ranks;
+static int np;
+
+static void do_op(MPI_Comm comm, int op, MPI_Group failed, int nf)
+{
+    MPI_Group g, group_c;
+    ftf_cache_t* fc;
+    int i, flag, *ranks_gf, *ranks_gc;
+
+    switch(op) {
+    case OP_GET:
+        ftf_get_failed(comm, &g);
+        ftf_group_free(&g);
+        break;
+    case OP_ACK:
+        ftf_ack_failed(comm, &g);
+        ftf_group_free(&g);
+        break;
+    case OP_TRANSLATE:
+        ftf_translate(comm, failed, nf, ranks);
+        break;
+    case OP_TRANSLATE_MALLOC:
+        ranks_gf = (int*)malloc(nf * sizeof(int));
+        ranks_gc = (int*)malloc(nf * sizeof(int));
+        MPI_Comm_group(comm, &group_c);
+        for(i = 0; i < nf; i++)
+            ranks_gf[i] = i;
+        MPI_Group_translate_ranks(failed, nf, ranks_gf, group_c, ranks_gc);
+        MPI_Group_free(&group_c);
+        free(ranks_gf); free(ranks_gc);
+        break;
+    case OP_IS_REVOKED:
+        ftf_is_revoked(comm, &flag);
+        break;
+    case OP_CACHE_UPDATE:
+        ftf_cache_update(comm, &fc);
+        break;
+    case OP_IS_FAILED:
+        fc = ftf_cache_get(comm);
+        for(i = 0; i < np; i++)
+            flag = ftf_is_failed(fc, i);
+        break;
+    case OP_LEGACY_ACK:
+        MPIX_Comm_failure_ack(comm);
+        MPIX_Comm_failure_get_acked(comm, &g);
+        ftf_group_free(&g);
+        break;
+    }
+}
+
+/* returns once all the survivors know of (at least) nf failures */
+static void wait_failures(MPI_Comm comm, int nf)
+{
+    MPI_Group g;
+    int flag, n;
+
+    do {
+        ftf_ack_failed(comm, &g);
+        MPI_Group_size(g, &n);
+        ftf_group_free(&g);
+        /* the error code may differ, the value is the same everywhere */
+        flag = (n >= nf);
+        MPIX_Comm_agree(comm, &flag);
+    } while( !flag );
+}
+
+/* the calls on comm, synchronized and reported on scomm */
+static void measure(MPI_Comm comm, MPI_Comm scomm, int nf, int nb)
+{
+    stat_t s;
+    MPI_Group failed;
+    double start, mean, max;
+    int op, i, rank, size;
+
+    MPI_Comm_rank(scomm, &rank);
+    MPI_Comm_size(scomm, &size);
+    ftf_ack_failed(comm, &failed);
+
+    for(op = 0; op < NB_OPS; op++) {
+        if( OP_LEGACY_ACK == op && !FTF_GET_FAILED ) continue;
+        stat_init(&s);
+        MPI_Barrier(scomm);
+        do_op(comm, op, failed, nf);
+        for(i = 0; i < nb; i++) {
+            start = MPI_Wtime();
+            do_op(comm, op, failed, nf);
+            stat_record(&s, MPI_Wtime() - start);
+        }
+        mean = stat_get_mean(&s);
+        MPI_Reduce(&mean, &max, 1, MPI_DOUBLE, MPI_MAX, 0, scomm);
+        if( 0 == rank )
+            printf("FAILED %d %s %g s (stdev %g ) per call, max over %d ranks (average over %d calls)\n",
+                   nf, op_names[op], max, stat_get_stdev(&s), size, nb);
+    }
+    ftf_group_free(&failed);
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, c, nb = 1000, mf = -1, nf, flag;
+    MPI_Comm scomm;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+    while(1) {
+        static struct option long_options[] = {
+            { "number",       1, 0, 'n' },
+            { "max-faults",   1, 0, 'm' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "n:m:", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 'n':
+            nb = atoi(optarg);
+            break;
+        case 'm':
+            mf = atoi(optarg);
+            break;
+        }
+    }
+    if( mf < 0 || mf >= np ) mf = np / 2;
+
+    ranks = (int*)malloc(np * sizeof(int));
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+    if( 0 == rank )
+        printf("# %d procs, up to %d failures, using %s\n", np, mf, FTF_API_NAME);
+
+    measure(MPI_COMM_WORLD, MPI_COMM_WORLD, 0, nb);
+
+    for(nf = 1; nf <= mf; nf = (nf * 2 > mf && nf < mf)? mf: nf * 2) {
+        flag = 1;
+        MPIX_Comm_agree(MPI_COMM_WORLD, &flag);
+        if( rank >= np - nf ) {
+            raise(SIGKILL); do { pause(); } while(1);
+        }
+        wait_failures(MPI_COMM_WORLD, nf);
+        MPIX_Comm_shrink(MPI_COMM_WORLD, &scomm);
+        measure(MPI_COMM_WORLD, scomm, nf, nb);
+        MPI_Comm_free(&scomm);
+    }
+
+    free(ranks);
+    MPI_Finalize();
+
+    return 0;
+}
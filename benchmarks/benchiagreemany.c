@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2014-2019 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ *
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Concurrent MPIX_Comm_iagree on S communicators (S = 1, 2, 4... up to
+ * -s), as several sub-communicators validated at the same time:
+ *  - disjoint: G = min(S, np/2) groups, the communicator s has the ranks
+ *    r with r % G == s % G;
+ *  - overlapping: the communicator s has half of the ranks, from the
+ *    rank s*np/S on, cyclically;
+ *  - nested: the communicator s has the first np/2^(s%L) ranks, the
+ *    smallest having 2.
+ * Each rank posts the agreements of the communicators it belongs to and
+ * waits for all of them. The time (max over the ranks) is compared to the
+ * same agreements done one after the other with MPIX_Comm_agree: a ratio
+ * close to 1 means that the runtime serializes them. Agreements per
+ * second count the S agreements.
+ * With -f, that rank dies right after posting its agreements on S = -s
+ * communicators of the last topology: the time for the others to
+ * complete them (in error where it was a member), then of a concurrent
+ * round once the failure is acknowledged, are reported.
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <signal.h>
+#include <math.h>
+
+/** Knuth algorithm for online numerically stable computation of variance */
+typedef struct {
+    int     n;
+    double  mean;
+    double  m2;
+} stat_t;
+
+static inline double stat_get_mean(stat_t *s) {
+    return s->mean;
+}
+
+static inline double stat_get_stdev(stat_t *s) {
+    if( s->n > 1 )
+        return sqrt(s->m2/(double)(s->n-1));
+    return NAN;
+}
+
+static inline void stat_record(stat_t *s, double v) {
+    double delta;
+    s->n++;
+    delta = v - s->mean;
+    s->mean += delta / (double)s->n;
+    s->m2 += delta * (v - s->mean);
+}
+
+static inline void stat_init(stat_t *s) {
+    s->n    = 0;
+    s->mean = 0.0;
+    s->m2   = 0.0;
+}
+
+#define TOPO_DISJOINT    0
+#define TOPO_OVERLAPPING 1
+#define TOPO_NESTED      2
+#define NB_TOPOS         3
+
+static const char* topo_names[NB_TOPOS] = { "disjoint", "overlapping", "nested" };
+
+/* is r a member of the communicator s out of S */
+static int member(int topo, int s, int S, int r, int np)
+{
+    int g, first, l, levels;
+
+    switch(topo) {
+    case TOPO_DISJOINT:
+        g = (S < np / 2)? S: np / 2;
+        if( g < 1 ) g = 1;
+        return (r % g) == (s % g);
+    case TOPO_OVERLAPPING:
+        first = (int)((long)s * np / S);
+        return ((r - first + np) % np) < (np + 1) / 2;
+    case TOPO_NESTED:
+        for(levels = 1; (np >> levels) >= 2; levels++);
+        l = np >> (s % levels);
+        return r < ((l < 2)? 2: l);
+    }
+    return 0;
+}
+
+/* the communicators this rank is a member of, out of S */
+static int create(int topo, int S, MPI_Comm* comms)
+{
+    int s, n = 0, rank, np;
+    MPI_Comm comm;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+    for(s = 0; s < S; s++) {
+        MPI_Comm_split(MPI_COMM_WORLD, member(topo, s, S, rank, np)? 0: MPI_UNDEFINED,
+                       rank, &comm);
+        if( MPI_COMM_NULL == comm ) continue;
+        MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN);
+        comms[n++] = comm;
+    }
+    return n;
+}
+
+/* the agreements on the n communicators, at once; returns the number of
+ * them that failed */
+static int concurrent(MPI_Comm* comms, int n, int* flags, MPI_Request* reqs,
+                      MPI_Status* statuses)
+{
+    int i, rc, nerr = 0;
+
+    for(i = 0; i < n; i++) {
+        flags[i] = 1;
+        MPIX_Comm_iagree(comms[i], &flags[i], &reqs[i]);
+    }
+    rc = MPI_Waitall(n, reqs, statuses);
+    if( MPI_ERR_IN_STATUS == rc ) {
+        for(i = 0; i < n; i++)
+            if( MPI_SUCCESS != statuses[i].MPI_ERROR ) nerr++;
+    }
+    else if( MPI_SUCCESS != rc ) nerr = n;
+    return nerr;
+}
+
+static void sequential(MPI_Comm* comms, int n, int* flags)
+{
+    int i;
+
+    for(i = 0; i < n; i++) {
+        flags[i] = 1;
+        MPIX_Comm_agree(comms[i], &flags[i]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, np, c, i, S, n, topo, nerr, maxs = 1024, nb = 20, victim = -1;
+    int first = 0, last = NB_TOPOS - 1;
+    MPI_Comm* comms;
+    MPI_Request* reqs;
+    MPI_Status* statuses;
+    int* flags;
+    double start, t[2], mt[2];
+    stat_t sc, ss;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+    while(1) {
+        static struct option long_options[] = {
+            { "simultaneous", 1, 0, 's' },
+            { "number",       1, 0, 'n' },
+            { "topology",     1, 0, 't' },
+            { "fault",        1, 0, 'f' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "s:n:t:f:", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 's':
+            maxs = atoi(optarg);
+            break;
+        case 'n':
+            nb = atoi(optarg);
+            break;
+        case 't':
+            for(first = NB_TOPOS - 1; first > 0 && strcmp(optarg, topo_names[first]); first--);
+            last = first;
+            break;
+        case 'f':
+            victim = atoi(optarg);
+            break;
+        }
+    }
+
+    comms = (MPI_Comm*)malloc(maxs * sizeof(MPI_Comm));
+    reqs = (MPI_Request*)malloc(maxs * sizeof(MPI_Request));
+    statuses = (MPI_Status*)malloc(maxs * sizeof(MPI_Status));
+    flags = (int*)malloc(maxs * sizeof(int));
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+
+    for(topo = first; topo <= last; topo++) {
+        for(S = 1; S <= maxs; S *= 2) {
+            n = create(topo, S, comms);
+            stat_init(&sc);
+            stat_init(&ss);
+            concurrent(comms, n, flags, reqs, statuses);
+            for(i = 0; i < nb; i++) {
+                MPI_Barrier(MPI_COMM_WORLD);
+                start = MPI_Wtime();
+                concurrent(comms, n, flags, reqs, statuses);
+                stat_record(&sc, MPI_Wtime() - start);
+                MPI_Barrier(MPI_COMM_WORLD);
+                start = MPI_Wtime();
+                sequential(comms, n, flags);
+                stat_record(&ss, MPI_Wtime() - start);
+            }
+            t[0] = stat_get_mean(&sc); t[1] = stat_get_mean(&ss);
+            MPI_Reduce(t, mt, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+            if( 0 == rank )
+                printf("IAGREE %s %d communicators: concurrent %g s (%g agreements/s, stdev %g on rank 0), sequential %g s, ratio %g (average over %d)\n",
+                       topo_names[topo], S, mt[0], S / mt[0], stat_get_stdev(&sc),
+                       mt[1], mt[0] / mt[1], nb);
+            if( topo == last && S * 2 > maxs && 0 <= victim && victim < np ) break;
+            for(i = 0; i < n; i++)
+                MPI_Comm_free(&comms[i]);
+        }
+    }
+    if( !(0 <= victim && victim < np) ) goto done;
+
+    /* the communicators of the last round are still there */
+    MPI_Barrier(MPI_COMM_WORLD);
+    if( rank == victim ) {
+        for(i = 0; i < n; i++) {
+            flags[i] = 1;
+            MPIX_Comm_iagree(comms[i], &flags[i], &reqs[i]);
+        }
+        raise(SIGKILL); do { pause(); } while(1);
+    }
+    start = MPI_Wtime();
+    nerr = concurrent(comms, n, flags, reqs, statuses);
+    t[0] = MPI_Wtime() - start;
+    printf("IAGREE_DURING_FAILURE %g s on rank %d, %d agreements in error out of %d\n",
+           t[0], rank, nerr, n);
+
+    for(i = 0; i < n; i++)
+        MPIX_Comm_failure_ack(comms[i]);
+    start = MPI_Wtime();
+    nerr = concurrent(comms, n, flags, reqs, statuses);
+    t[0] = MPI_Wtime() - start;
+    printf("IAGREE_AFTER_FAILURE %g s on rank %d, %d agreements in error out of %d\n",
+           t[0], rank, nerr, n);
+    for(i = 0; i < n; i++)
+        MPI_Comm_free(&comms[i]);
+
+  done:
+    free(comms); free(reqs); free(statuses); free(flags);
+    MPI_Finalize();
+
+    return 0;
+}
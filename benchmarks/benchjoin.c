@@ -0,0 +1,212 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Replacement of dead processes by spawned processes, against processes
+ * started outside of the application that connect to it (see
+ * ../tutorial/ftreplace.h). In each of -c cycles, the last -k ranks die,
+ * the survivors detect it, revoke and shrink, then replace them, in turn
+ * with ftr_spawn and with ftr_accept (-m spawn or -m join for only one
+ * of them). For ftr_accept, rank 0 starts the new processes with the
+ * launcher command (-L, "mpiexec --with-ft mpi" by default) and the
+ * arguments of this program plus -J, in the background, unless they are
+ * already started (-P: e.g. 'mpiexec -np K benchjoin -J -s ... &', before
+ * each cycle). The port name goes through the service -s: a file when
+ * there is a '/' in it (./benchjoin.port by default), MPI_Publish_name
+ * otherwise. With Open MPI 4, jobs started apart can connect only through
+ * an ompi-server: run it, and give '--ompi-server file:<uri>' to mpiexec
+ * for the application and in -L. Reported, max over the processes: the
+ * time from the shrink to the repaired communicator, for each cycle and
+ * on average.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include "../tutorial/ftreplace.h"
+
+#define M_SPAWN 0
+#define M_JOIN  1
+
+static const char* method_names[2] = { "spawn", "join" };
+
+static int gargc;
+static char** gargv;
+
+/* appends arg to cmd, between single quotes for the shell */
+static int quote(char* cmd, int len, int size, const char* arg)
+{
+    if( len < size - 2 ) cmd[len++] = ' ';
+    if( len < size - 2 ) cmd[len++] = '\'';
+    for(; '\0' != *arg && len < size - 5; arg++) {
+        if( '\'' == *arg ) {
+            memcpy(cmd + len, "'\\''", 4);  /* ' closes, \' is a quote, ' reopens */
+            len += 4;
+        }
+        else cmd[len++] = *arg;
+    }
+    if( len < size - 1 ) cmd[len++] = '\'';
+    cmd[len] = '\0';
+    return len;
+}
+
+/* the new processes run this program again, with -J; the launcher is
+ * a command line, the arguments are passed as they are */
+static void launch(const char* launcher, int n)
+{
+    char cmd[4096];
+    int i, len;
+
+    len = snprintf(cmd, sizeof(cmd), "%s -np %d", launcher, n);
+    for(i = 0; i < gargc && len < (int)sizeof(cmd) - 1; i++)
+        len = quote(cmd, len, sizeof(cmd), gargv[i]);
+    if( len < (int)sizeof(cmd) )
+        snprintf(cmd + len, sizeof(cmd) - len, " -J &");
+    if( 0 != system(cmd) )
+        fprintf(stderr, "Failed to launch '%s'\n", cmd);
+}
+
+int main( int argc, char* argv[] ) {
+    MPI_Comm world, scomm, ncomm, parent;
+    int rank, size, srank, c, rc, cycle, method, epoch;
+    int ncycles = 4, k = 1, only = -1, prestarted = 0, joiner = 0, newcomer;
+    char* service = "./benchjoin.port";
+    char* launcher = "mpiexec --with-ft mpi";
+    double start, t, maxt, sum[2] = { 0.0, 0.0 };
+    int n[2] = { 0, 0 };
+
+    gargc = argc; gargv = argv;
+    MPI_Init( &argc, &argv );
+
+    while(1) {
+        static struct option long_options[] = {
+            { "cycles",       1, 0, 'c' },
+            { "kills",        1, 0, 'k' },
+            { "method",       1, 0, 'm' },
+            { "service",      1, 0, 's' },
+            { "launcher",     1, 0, 'L' },
+            { "prestarted",   0, 0, 'P' },
+            { "join",         0, 0, 'J' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "c:k:m:s:L:PJ", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 'c':
+            ncycles = atoi(optarg);
+            break;
+        case 'k':
+            k = atoi(optarg);
+            break;
+        case 'm':
+            only = strcmp(optarg, method_names[M_SPAWN])? M_JOIN: M_SPAWN;
+            break;
+        case 's':
+            service = optarg;
+            break;
+        case 'L':
+            launcher = optarg;
+            break;
+        case 'P':
+            prestarted = 1;
+            break;
+        case 'J':
+            joiner = 1;
+            break;
+        }
+    }
+
+    MPI_Comm_get_parent( &parent );
+    newcomer = joiner || (MPI_COMM_NULL != parent);
+    if( newcomer ) {
+        ftr_join( service, &cycle, &world );
+        if( MPI_COMM_NULL == world ) {
+            /* more processes than needed were started */
+            MPI_Finalize();
+            return EXIT_SUCCESS;
+        }
+    }
+    else {
+        MPI_Comm_dup( MPI_COMM_WORLD, &world );
+        cycle = 0;
+    }
+    MPI_Comm_set_errhandler( world, MPI_ERRORS_RETURN );
+
+    for(; cycle < ncycles; cycle++) {
+        method = (only < 0)? cycle % 2: only;
+        if( newcomer ) {
+            /* joining after the recovery of this cycle */
+            t = 0.0;
+            newcomer = 0;
+        }
+        else {
+            MPI_Comm_size( world, &size );
+            MPI_Comm_rank( world, &rank );
+            if( size <= k ) break;
+
+            MPI_Barrier( world );
+            if( rank >= size - k ) {
+                raise(SIGKILL); do { pause(); } while(1);
+            }
+            do {
+                rc = MPI_Barrier( world );
+            } while( MPI_SUCCESS == rc );
+            MPIX_Comm_revoke( world );
+            MPIX_Comm_shrink( world, &scomm );
+            MPI_Comm_rank( scomm, &srank );
+
+            start = MPI_Wtime();
+            epoch = cycle;
+            if( M_SPAWN == method ) {
+                ftr_spawn( world, scomm, gargv[0], &gargv[1], &epoch, &ncomm );
+            }
+            else {
+                if( 0 == srank && !prestarted ) launch( launcher, k );
+                ftr_accept( world, scomm, service, &epoch, &ncomm );
+            }
+            t = MPI_Wtime() - start;
+            MPI_Comm_free( &scomm );
+            MPI_Comm_free( &world );
+            world = ncomm;
+            MPI_Comm_set_errhandler( world, MPI_ERRORS_RETURN );
+        }
+
+        MPI_Comm_rank( world, &rank );
+        MPI_Reduce( &t, &maxt, 1, MPI_DOUBLE, MPI_MAX, 0, world );
+        if( 0 == rank ) {
+            printf("REPLACE %-5s cycle %d, %d processes: %g s\n",
+                   method_names[method], cycle, k, maxt);
+            sum[method] += maxt;
+            n[method]++;
+        }
+    }
+
+    MPI_Comm_rank( world, &rank );
+    if( 0 == rank )
+        for(method = M_SPAWN; method <= M_JOIN; method++)
+            if( n[method] )
+                printf("REPLACE %-5s average %g s over %d cycles\n",
+                       method_names[method], sum[method] / n[method], n[method]);
+
+    MPI_Comm_free( &world );
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2019-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ *
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Message rate between pairs of processes while others die, after
+ * stress/pingpairs.c: the even ranks send to the next odd rank windows
+ * of -w messages of -s bytes (at least an int), from -t threads (each on
+ * its own communicator, under MPI_THREAD_MULTIPLE), for -b seconds
+ * before the failures, -d seconds during their detection, and -a
+ * seconds after. At the end of the first period, the ranks r with
+ * r%8 == 1 (receivers) and r%8 == 2 (senders) die, as in pingpairs (-n:
+ * no failure). A pair whose peer died stops at its first error.
+ * Reported: the messages per second per pair in each period, for the
+ * pairs not involved in a failure, and the time for the others to see
+ * it. Then it is checked that the pairs not involved keep, in the two
+ * last periods, at least (100 - -T)% of their rate before the failures:
+ * if not, the program reports FAILED and exits with an error.
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+#define NB_PERIODS 3
+
+static const char* period_names[NB_PERIODS] = { "BEFORE", "DURING", "AFTER" };
+
+static int peer, sender;
+static int msgsize = 8, window = 64;
+static double periods[NB_PERIODS] = { 2.0, 1.0, 2.0 };
+static double t0;
+
+typedef struct {
+    pthread_t tid;
+    MPI_Comm  comm;
+    long      count[NB_PERIODS];
+    double    error;   /* when it saw the failure of peer, -1 if it did not */
+} thread_t;
+
+static int period(double t)
+{
+    if( t < periods[0] ) return 0;
+    if( t < periods[0] + periods[1] ) return 1;
+    return 2;
+}
+
+/* the sender tells in the last message of each window whether there is
+ * another one */
+static void* pair(void* arg)
+{
+    thread_t* th = (thread_t*)arg;
+    MPI_Request* reqs = (MPI_Request*)malloc(window * sizeof(MPI_Request));
+    char* bufs = (char*)calloc((size_t)window, msgsize);
+    int* more = (int*)(bufs + (size_t)(window - 1) * msgsize);
+    double end = periods[0] + periods[1] + periods[2], t;
+    int i, rc;
+
+    th->error = -1.0;
+    do {
+        if( sender ) *more = (MPI_Wtime() - t0 < end);
+        for(i = 0; i < window; i++) {
+            if( sender )
+                MPI_Isend(bufs + (size_t)i * msgsize, msgsize, MPI_BYTE, peer, 1, th->comm, &reqs[i]);
+            else
+                MPI_Irecv(bufs + (size_t)i * msgsize, msgsize, MPI_BYTE, peer, 1, th->comm, &reqs[i]);
+        }
+        rc = MPI_Waitall(window, reqs, MPI_STATUSES_IGNORE);
+        t = MPI_Wtime() - t0;
+        if( MPI_SUCCESS != rc ) {
+            th->error = t - periods[0];
+            break;
+        }
+        th->count[period(t)] += window;
+    } while( *more );
+    free(reqs); free(bufs);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int provided, rank, np, c, i, p, victim, involved, nthreads = 1, failures = 1;
+    double tolerance = 10.0, rates[NB_PERIODS], v[NB_PERIODS + 2], minv[NB_PERIODS + 2],
+        sumv[NB_PERIODS + 2], maxv[NB_PERIODS + 2], error;
+    thread_t* threads;
+    MPI_Comm scomm;
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+    while(1) {
+        static struct option long_options[] = {
+            { "size",         1, 0, 's' },
+            { "window",       1, 0, 'w' },
+            { "threads",      1, 0, 't' },
+            { "before",       1, 0, 'b' },
+            { "during",       1, 0, 'd' },
+            { "after",        1, 0, 'a' },
+            { "tolerance",    1, 0, 'T' },
+            { "no-failure",   0, 0, 'n' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "s:w:t:b:d:a:T:n", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 's':
+            msgsize = atoi(optarg);
+            break;
+        case 'w':
+            window = atoi(optarg);
+            break;
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 'b':
+            periods[0] = atof(optarg);
+            break;
+        case 'd':
+            periods[1] = atof(optarg);
+            break;
+        case 'a':
+            periods[2] = atof(optarg);
+            break;
+        case 'T':
+            tolerance = atof(optarg);
+            break;
+        case 'n':
+            failures = 0;
+            break;
+        }
+    }
+    if( msgsize < (int)sizeof(int) ) msgsize = sizeof(int);
+    if( np % 2 ) {
+        printf("This benchmark requires an even number of processes to make pairs, found np=%d\n", np);
+        MPI_Abort(MPI_COMM_WORLD, np);
+    }
+    if( nthreads > 1 && MPI_THREAD_MULTIPLE != provided ) {
+        if( 0 == rank ) printf("No MPI_THREAD_MULTIPLE, using 1 thread\n");
+        nthreads = 1;
+    }
+
+    sender = (0 == rank % 2);
+    peer = sender? rank + 1: rank - 1;
+    victim = failures && (1 == rank % 8 || 2 == rank % 8);
+    involved = failures && (victim || 1 == peer % 8 || 2 == peer % 8);
+
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+    threads = (thread_t*)calloc(nthreads, sizeof(thread_t));
+    for(i = 0; i < nthreads; i++) {
+        MPI_Comm_dup(MPI_COMM_WORLD, &threads[i].comm);
+        MPI_Comm_set_errhandler(threads[i].comm, MPI_ERRORS_RETURN);
+    }
+    if( 0 == rank )
+        printf("# %d pairs, %d threads, windows of %d messages of %d bytes, %s\n",
+               np / 2, nthreads, window, msgsize, failures? "with failures": "without failure");
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    t0 = MPI_Wtime();
+    for(i = 0; i < nthreads; i++)
+        pthread_create(&threads[i].tid, NULL, pair, &threads[i]);
+    if( victim ) {
+        while( MPI_Wtime() - t0 < periods[0] ) usleep(1000);
+        raise(SIGKILL); do { pause(); } while(1);
+    }
+    error = -1.0;
+    for(p = 0; p < NB_PERIODS; p++) rates[p] = 0.0;
+    for(i = 0; i < nthreads; i++) {
+        pthread_join(threads[i].tid, NULL);
+        for(p = 0; p < NB_PERIODS; p++) rates[p] += threads[i].count[p] / periods[p];
+        if( threads[i].error > error ) error = threads[i].error;
+        MPI_Comm_free(&threads[i].comm);
+    }
+
+    /* the pairs not involved, seen from their sender, and the time to
+     * see the failure on the others */
+    if( failures ) MPIX_Comm_shrink(MPI_COMM_WORLD, &scomm);
+    else MPI_Comm_dup(MPI_COMM_WORLD, &scomm);
+    MPI_Comm_rank(scomm, &rank);
+    for(p = 0; p < NB_PERIODS; p++) v[p] = (sender && !involved)? rates[p]: 0.0;
+    v[NB_PERIODS] = (sender && !involved && rates[0] > 0.0)?
+        ((rates[1] < rates[2])? rates[1]: rates[2]) / rates[0]: 1e9;
+    v[NB_PERIODS + 1] = (sender && !involved)? 1.0: 0.0;
+    MPI_Reduce(v, sumv, NB_PERIODS + 2, MPI_DOUBLE, MPI_SUM, 0, scomm);
+    for(p = 0; p < NB_PERIODS; p++) if( !(sender && !involved) ) v[p] = 1e30;
+    MPI_Reduce(v, minv, NB_PERIODS + 2, MPI_DOUBLE, MPI_MIN, 0, scomm);
+    v[0] = involved? error: -1.0;
+    MPI_Reduce(v, maxv, 1, MPI_DOUBLE, MPI_MAX, 0, scomm);
+    MPI_Comm_free(&scomm);
+
+    c = EXIT_SUCCESS;
+    if( 0 == rank ) {
+        for(p = 0; p < NB_PERIODS; p++)
+            printf("MSGRATE %s %g msg/s per pair (min %g ) over %g pairs not involved, %g s\n",
+                   period_names[p], sumv[p] / sumv[NB_PERIODS + 1], minv[p],
+                   sumv[NB_PERIODS + 1], periods[p]);
+        if( failures )
+            printf("DETECTION %g s after the failures, at the latest, for the pairs involved\n", maxv[0]);
+        if( 0.0 == sumv[NB_PERIODS + 1] ) {
+            printf("ASSERT no pair left out of the failures, nothing to check\n");
+        }
+        else if( minv[NB_PERIODS] >= 1.0 - tolerance / 100.0 ) {
+            printf("ASSERT pairs not involved keep their rate: PASSED (worst %.1f%% of the rate before)\n",
+                   100.0 * minv[NB_PERIODS]);
+        }
+        else {
+            printf("ASSERT pairs not involved keep their rate: FAILED (worst %.1f%% of the rate before, tolerance %g%%)\n",
+                   100.0 * minv[NB_PERIODS], tolerance);
+            c = EXIT_FAILURE;
+        }
+    }
+
+    free(threads);
+    MPI_Finalize();
+
+    return c;
+}
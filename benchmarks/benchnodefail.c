@@ -0,0 +1,246 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Recovery from correlated failures: whole nodes die at once, as in
+ * stress/kill_node.c, and we time each phase of the recovery. For k = 1,
+ * 2... up to -k, the last k nodes die: on each, the first rank kills its
+ * daemon (Open MPI), then all the ranks of the node die. With -g G, the
+ * nodes are emulated by blocks of G consecutive ranks that die together,
+ * without killing any daemon (to run on a single node). The node of rank
+ * 0 never dies. The survivors call MPI_Barrier until it fails
+ * (detection), revoke, acknowledge the failures, agree, and shrink;
+ * with -r, they also spawn as many processes as have died, and merge with
+ * them, as in benchrespawn.c, to get back a world of the same size.
+ * Reported, max over the survivors: the time spent in each phase, and
+ * how many of the dead processes were acknowledged at the slowest rank.
+ * Without -r, each case costs k nodes.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include "../tutorial/ftfailed.h"
+
+#define NB_PHASES 6
+
+static char** gargv;
+
+/* the node of each rank: blocks of g consecutive ranks with g > 0, the
+ * shared memory domains otherwise, numbered in the order of their
+ * lowest rank */
+static void nodes(MPI_Comm comm, int g, int* node, int* nnodes, int* lrank)
+{
+    MPI_Comm ncomm, lcomm;
+    int rank, size, v[2];
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    if( g > 0 ) {
+        *node = rank / g;
+        *nnodes = (size + g - 1) / g;
+        *lrank = rank % g;
+        return;
+    }
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &ncomm);
+    MPI_Comm_rank(ncomm, lrank);
+    MPI_Comm_split(comm, (0 == *lrank)? 0: MPI_UNDEFINED, rank, &lcomm);
+    if( 0 == *lrank ) {
+        MPI_Comm_rank(lcomm, &v[0]);
+        MPI_Comm_size(lcomm, &v[1]);
+        MPI_Comm_free(&lcomm);
+    }
+    MPI_Bcast(v, 2, MPI_INT, 0, ncomm);
+    *node = v[0];
+    *nnodes = v[1];
+    MPI_Comm_free(&ncomm);
+}
+
+/* The survivors (scomm, shrunk from comm) spawn the replacements, and
+ * rank 0 sends each the rank of the dead process it replaces and the
+ * case it joins; then all merge and take their rank in comm. No failure
+ * is expected during the recovery (see benchrespawn.c for the retries).
+ * A spawnee calls it with MPI_COMM_NULL. */
+static int replace(MPI_Comm comm, MPI_Comm scomm, int* k, MPI_Comm* newcomm)
+{
+    MPI_Comm icomm, mcomm;
+    MPI_Group cgrp, sgrp, dgrp;
+    int i, nc, ns, srank, crank, v[2], rc;
+
+    if( MPI_COMM_NULL == comm ) {
+        MPI_Comm_get_parent(&icomm);
+        MPI_Recv(v, 2, MPI_INT, 0, 1, icomm, MPI_STATUS_IGNORE);
+        crank = v[0];
+        *k = v[1];
+    }
+    else {
+        MPI_Comm_size(comm, &nc);
+        MPI_Comm_size(scomm, &ns);
+        MPI_Comm_rank(comm, &crank);
+        MPI_Comm_rank(scomm, &srank);
+        MPI_Comm_spawn(gargv[0], &gargv[1], nc - ns, MPI_INFO_NULL,
+                       0, scomm, &icomm, MPI_ERRCODES_IGNORE);
+        if( 0 == srank ) {
+            MPI_Comm_group(comm, &cgrp);
+            MPI_Comm_group(scomm, &sgrp);
+            MPI_Group_difference(cgrp, sgrp, &dgrp);
+            for(i = 0; i < nc - ns; i++) {
+                MPI_Group_translate_ranks(dgrp, 1, &i, cgrp, &v[0]);
+                v[1] = *k;
+                MPI_Send(v, 2, MPI_INT, i, 1, icomm);
+            }
+            MPI_Group_free(&cgrp); MPI_Group_free(&sgrp); MPI_Group_free(&dgrp);
+        }
+    }
+    MPI_Intercomm_merge(icomm, 1, &mcomm);
+    rc = MPI_Comm_split(mcomm, 1, crank, newcomm);
+    MPI_Comm_free(&mcomm);
+    MPI_Comm_free(&icomm);
+    return rc;
+}
+
+int main( int argc, char* argv[] ) {
+    MPI_Comm fcomm, scomm, ncomm, parent;
+    MPI_Group fgrp;
+    int rank, size, ns, c, k, i, rc, flag, node, nnodes, lrank, nf;
+    int maxk = 1, g = 0, respawn = 0, spawnee;
+    double start, t[NB_PHASES], maxt[NB_PHASES], mindetect, mind;
+    int cnt[2], mincnt[2];
+
+    gargv = argv;
+    MPI_Init( &argc, &argv );
+
+    while(1) {
+        static struct option long_options[] = {
+            { "nodes",        1, 0, 'k' },
+            { "group",        1, 0, 'g' },
+            { "respawn",      0, 0, 'r' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "k:g:r", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 'k':
+            maxk = atoi(optarg);
+            break;
+        case 'g':
+            g = atoi(optarg);
+            break;
+        case 'r':
+            respawn = 1;
+            break;
+        }
+    }
+
+    MPI_Comm_get_parent( &parent );
+    spawnee = (MPI_COMM_NULL != parent);
+    if( spawnee ) {
+        replace( MPI_COMM_NULL, MPI_COMM_NULL, &k, &fcomm );
+    }
+    else {
+        MPI_Comm_dup( MPI_COMM_WORLD, &fcomm );
+        k = 1;
+    }
+    MPI_Comm_set_errhandler( fcomm, MPI_ERRORS_RETURN );
+    MPI_Comm_rank( fcomm, &rank );
+
+    if( 0 == rank ) printf(
+        "## Nodes Procs # Detect (min .. max)         # Ack           # Agree         # Shrink        # Replace       # Total         # Acked\n");
+
+    for(; k <= maxk; k++) {
+        if( spawnee ) {
+            /* joining after the recovery of case k */
+            memset(t, 0, sizeof(t));
+            mindetect = 1e30;
+            cnt[0] = cnt[1] = 1 << 30;
+            spawnee = 0;
+        }
+        else {
+            MPI_Comm_size( fcomm, &size );
+            MPI_Comm_rank( fcomm, &rank );
+            nodes( fcomm, g, &node, &nnodes, &lrank );
+            if( nnodes <= k ) break;
+
+            MPI_Barrier( fcomm );
+            if( node >= nnodes - k ) {
+                if( 0 == g && 0 == lrank ) kill( getppid(), SIGKILL );
+                raise(SIGKILL); do { pause(); } while(1);
+            }
+
+            /* detection */
+            start = MPI_Wtime();
+            do {
+                rc = MPI_Barrier( fcomm );
+            } while( MPI_SUCCESS == rc );
+            t[0] = MPI_Wtime() - start;
+            MPIX_Comm_revoke( fcomm );
+
+            /* acknowledgement */
+            start = MPI_Wtime();
+            ftf_ack_failed( fcomm, &fgrp );
+            MPI_Group_size( fgrp, &nf );
+            ftf_group_free( &fgrp );
+            t[1] = MPI_Wtime() - start;
+
+            /* agreement, on the revoked communicator with the dead */
+            start = MPI_Wtime();
+            flag = 1;
+            MPIX_Comm_agree( fcomm, &flag );
+            t[2] = MPI_Wtime() - start;
+
+            start = MPI_Wtime();
+            MPIX_Comm_shrink( fcomm, &scomm );
+            t[3] = MPI_Wtime() - start;
+            MPI_Comm_set_errhandler( scomm, MPI_ERRORS_RETURN );
+            MPI_Comm_size( scomm, &ns );
+
+            start = MPI_Wtime();
+            if( respawn ) {
+                replace( fcomm, scomm, &k, &ncomm );
+                MPI_Comm_free( &scomm );
+            }
+            else {
+                ncomm = scomm;
+            }
+            t[4] = MPI_Wtime() - start;
+            MPI_Comm_free( &fcomm );
+            fcomm = ncomm;
+            MPI_Comm_set_errhandler( fcomm, MPI_ERRORS_RETURN );
+            MPI_Comm_rank( fcomm, &rank );
+            for(t[5] = 0.0, i = 0; i < 5; i++) t[5] += t[i];
+            mindetect = t[0];
+            cnt[0] = nf; cnt[1] = size - ns;
+        }
+
+        MPI_Reduce( t, maxt, NB_PHASES, MPI_DOUBLE, MPI_MAX, 0, fcomm );
+        MPI_Reduce( &mindetect, &mind, 1, MPI_DOUBLE, MPI_MIN, 0, fcomm );
+        MPI_Reduce( cnt, mincnt, 2, MPI_INT, MPI_MIN, 0, fcomm );
+        if( 0 == rank )
+            printf("%7d %5d # %13.5e .. %13.5e # %13.5e # %13.5e # %13.5e # %13.5e # %13.5e # %d / %d\n",
+                   k, mincnt[1], mind, maxt[0], maxt[1], maxt[2], maxt[3], maxt[4], maxt[5],
+                   mincnt[0], mincnt[1]);
+    }
+
+    MPI_Comm_free( &fcomm );
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2014-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ *
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Completion in error of many pending point-to-point requests, as after
+ * a neighbor dies in a pipeline. Each surviving rank posts R requests
+ * (R = 1000, 10000... up to -n), a third of each kind: MPI_Irecv from a
+ * rank that is about to die, MPI_Irecv from MPI_ANY_SOURCE, and MPI_Isend
+ * of -s bytes to a rank about to die. Then F ranks (1, 2, 4... up to
+ * -f) die, and the survivors MPI_Waitall. The requests on the dead
+ * ranks complete with MPIX_ERR_PROC_FAILED, the MPI_ANY_SOURCE ones
+ * remain pending (MPIX_ERR_PROC_FAILED_PENDING); they are completed by
+ * revoking the communicator. Reported, max over the ranks: the time to
+ * the return of the first MPI_Waitall, to the completion of all the
+ * requests, the CPU time spent meanwhile, the resident memory taken by
+ * the requests and given back once they complete, and how the requests
+ * completed. Each case costs F processes, and the survivors shrink
+ * before the next one.
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/* resident memory in kB */
+static long rss(void)
+{
+    char line[256];
+    long kb = -1;
+    FILE* f = fopen("/proc/self/status", "r");
+
+    if( NULL == f ) return -1;
+    while( NULL != fgets(line, sizeof(line), f) ) {
+        if( !strncmp(line, "VmRSS:", 6) ) {
+            kb = atol(line + 6);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+/* user and system time of the process, progress threads included */
+static double cpu(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+#define C_FAILED  0
+#define C_PENDING 1
+#define C_REVOKED 2
+#define C_SUCCESS 3
+#define C_OTHER   4
+#define NB_C      5
+
+static void classify(int n, MPI_Status* statuses, int rc, long* counts)
+{
+    int i, eclass;
+
+    for(i = 0; i < n; i++) {
+        if( MPI_ERR_IN_STATUS != rc ) {
+            counts[MPI_SUCCESS == rc? C_SUCCESS: C_OTHER]++;
+            continue;
+        }
+        MPI_Error_class(statuses[i].MPI_ERROR, &eclass);
+        if( MPI_SUCCESS == eclass ) counts[C_SUCCESS]++;
+        else if( MPIX_ERR_PROC_FAILED == eclass ) counts[C_FAILED]++;
+        else if( MPI_ERR_PENDING == eclass ||
+                 MPIX_ERR_PROC_FAILED_PENDING == eclass ) counts[C_PENDING]++;
+        else if( MPIX_ERR_REVOKED == eclass ) counts[C_REVOKED]++;
+        else counts[C_OTHER]++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, np, size, c, i, k, n, f, rc, maxn = 1000000, maxf = 1, msgsize = 0, victim;
+    MPI_Comm fcomm, scomm;
+    MPI_Request* reqs;
+    MPI_Status* statuses;
+    char* sbuf;
+    double start, cstart, t[4], mt[4];
+    long rss0, rss1, rss2, counts[NB_C], r[2 + NB_C], mr[2 + NB_C], sr[2 + NB_C];
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+    while(1) {
+        static struct option long_options[] = {
+            { "number",       1, 0, 'n' },
+            { "faults",       1, 0, 'f' },
+            { "size",         1, 0, 's' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "n:f:s:", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 'n':
+            maxn = atoi(optarg);
+            break;
+        case 'f':
+            maxf = atoi(optarg);
+            break;
+        case 's':
+            msgsize = atoi(optarg);
+            break;
+        }
+    }
+
+    reqs = (MPI_Request*)malloc(maxn * sizeof(MPI_Request));
+    statuses = (MPI_Status*)malloc(maxn * sizeof(MPI_Status));
+    sbuf = (char*)calloc(msgsize + 1, 1);
+    MPI_Comm_dup(MPI_COMM_WORLD, &fcomm);
+    MPI_Comm_set_errhandler(fcomm, MPI_ERRORS_RETURN);
+
+    for(f = 1; f <= maxf; f *= 2) {
+        for(n = 1000; n <= maxn; n *= 10) {
+            MPI_Comm_size(fcomm, &size);
+            MPI_Comm_rank(fcomm, &rank);
+            if( size <= f ) goto done;
+
+            MPI_Barrier(fcomm);
+            rss0 = rss();
+            start = MPI_Wtime();
+            if( rank < size - f ) {
+                for(i = 0; i < n; i++) {
+                    victim = size - f + (i / 3) % f;
+                    switch(i % 3) {
+                    case 0:
+                        MPI_Irecv(NULL, 0, MPI_BYTE, victim, 1, fcomm, &reqs[i]);
+                        break;
+                    case 1:
+                        MPI_Irecv(NULL, 0, MPI_BYTE, MPI_ANY_SOURCE, 1, fcomm, &reqs[i]);
+                        break;
+                    default:
+                        MPI_Isend(sbuf, msgsize, MPI_BYTE, victim, 1, fcomm, &reqs[i]);
+                        break;
+                    }
+                }
+            }
+            t[0] = MPI_Wtime() - start;
+            rss1 = rss();
+            MPI_Barrier(fcomm);
+
+            if( rank >= size - f ) {
+                raise(SIGKILL); do { pause(); } while(1);
+            }
+            memset(counts, 0, sizeof(counts));
+            cstart = cpu();
+            start = MPI_Wtime();
+            rc = MPI_Waitall(n, reqs, statuses);
+            t[1] = MPI_Wtime() - start;
+            classify(n, statuses, rc, counts);
+            if( counts[C_PENDING] ) {
+                /* the MPI_ANY_SOURCE receptions are still there */
+                for(k = 0, i = 0; i < n; i++)
+                    if( MPI_REQUEST_NULL != reqs[i] ) reqs[k++] = reqs[i];
+                MPIX_Comm_revoke(fcomm);
+                rc = MPI_Waitall(k, reqs, statuses);
+                counts[C_PENDING] -= k;
+                classify(k, statuses, rc, counts);
+            }
+            t[2] = MPI_Wtime() - start;
+            t[3] = cpu() - cstart;
+            rss2 = rss();
+
+            MPIX_Comm_shrink(fcomm, &scomm);
+            MPI_Comm_free(&fcomm);
+            fcomm = scomm;
+            MPI_Comm_set_errhandler(fcomm, MPI_ERRORS_RETURN);
+
+            r[0] = rss1 - rss0; r[1] = rss1 - rss2;
+            for(i = 0; i < NB_C; i++) r[2 + i] = counts[i];
+            MPI_Reduce(t, mt, 4, MPI_DOUBLE, MPI_MAX, 0, fcomm);
+            MPI_Reduce(r, mr, 2, MPI_LONG, MPI_MAX, 0, fcomm);
+            MPI_Reduce(r, sr, 2 + NB_C, MPI_LONG, MPI_SUM, 0, fcomm);
+            if( 0 == rank ) {
+                printf("PENDING %d requests %d failures: posted in %g s, first Waitall %g s, all completed %g s (%g us per request), CPU %g s\n",
+                       n, f, mt[0], mt[1], mt[2], mt[2] * 1e6 / n, mt[3]);
+                printf("PENDING %d requests %d failures: RSS %ld kB for the requests, %ld kB given back; per rank %g failed, %g revoked, %g succeeded, %g other\n",
+                       n, f, mr[0], mr[1], sr[2 + C_FAILED] / (double)(size - f),
+                       sr[2 + C_REVOKED] / (double)(size - f),
+                       sr[2 + C_SUCCESS] / (double)(size - f),
+                       sr[2 + C_OTHER] / (double)(size - f));
+            }
+        }
+    }
+
+  done:
+    MPI_Comm_free(&fcomm);
+    free(reqs); free(statuses); free(sbuf);
+    MPI_Finalize();
+
+    return 0;
+}
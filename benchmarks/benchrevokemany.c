@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2012-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ *
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Revoking and freeing many communicators at once, as a recovery does
+ * with the world, its rows and columns, and the duplicates of the
+ * libraries. For N from 10 up to -n (times 10), N communicators are
+ * created (duplicates of MPI_COMM_WORLD, or with -s alternately rows
+ * and columns of a process grid), each with -p pending MPI_Irecv, then
+ * revoked:
+ *  - single: rank 0 of MPI_COMM_WORLD revokes them all, one after the
+ *    other (with -s, the rows and columns it is not in are revoked by
+ *    their rank 0);
+ *  - concurrent: each communicator is revoked by one of its members,
+ *    spread over the ranks, all at the same time;
+ *  - cascade: the first communicator is revoked, and when a rank sees
+ *    it, it revokes the communicators it is rank 0 of.
+ * The revoke is complete at a rank when all its communicators have a
+ * pending request completed in error. The communicators are then freed.
+ * With -f, the requests are not completed but polled with
+ * MPIX_Comm_is_revoked, and freed with the communicators while pending.
+ * The requests completed, and the communicators seen revoked, leave the
+ * arrays that are waited on or polled, so that each call only costs
+ * what is still pending.
+ * This is repeated -c times, and the resident memory after each cycle
+ * tells whether something leaks. Times are the max over the ranks.
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h>
+
+#define MODE_SINGLE     0
+#define MODE_CONCURRENT 1
+#define MODE_CASCADE    2
+
+static const char* mode_names[3] = { "single", "concurrent", "cascade" };
+
+static int descending(const void* a, const void* b)
+{
+    return *(const int*)b - *(const int*)a;
+}
+
+/* resident memory in kB */
+static long rss(void)
+{
+    char line[256];
+    long kb = -1;
+    FILE* f = fopen("/proc/self/status", "r");
+
+    if( NULL == f ) return -1;
+    while( NULL != fgets(line, sizeof(line), f) ) {
+        if( !strncmp(line, "VmRSS:", 6) ) {
+            kb = atol(line + 6);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, np, c, i, j, n, cy, maxn = 10000, npend = 1, cycles = 3;
+    int mode = MODE_CONCURRENT, split = 0, freereqs = 0, rows, crank, csize;
+    int idx, count, flag, *indices, *seen, nseen, k, nact, *owner, nleft, *left;
+    MPI_Comm *comms;
+    MPI_Request *reqs;
+    double start, tcreate, trevoke, tfree, t[3], mt[3];
+    long rss0, rss1, rss2, r[3], mr[3], first = 0;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+    while(1) {
+        static struct option long_options[] = {
+            { "number",       1, 0, 'n' },
+            { "pending",      1, 0, 'p' },
+            { "cycles",       1, 0, 'c' },
+            { "mode",         1, 0, 'm' },
+            { "split",        0, 0, 's' },
+            { "free",         0, 0, 'f' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "n:p:c:m:sf", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 'n':
+            maxn = atoi(optarg);
+            break;
+        case 'p':
+            npend = atoi(optarg);
+            break;
+        case 'c':
+            cycles = atoi(optarg);
+            break;
+        case 'm':
+            for(mode = 2; mode > 0 && strcmp(optarg, mode_names[mode]); mode--);
+            break;
+        case 's':
+            split = 1;
+            break;
+        case 'f':
+            freereqs = 1;
+            break;
+        }
+    }
+    if( npend < 1 ) npend = 1;
+    for(rows = (int)sqrt((double)np); np % rows; rows--);
+
+    comms = (MPI_Comm*)malloc(maxn * sizeof(MPI_Comm));
+    reqs = (MPI_Request*)malloc((size_t)maxn * npend * sizeof(MPI_Request));
+    indices = (int*)malloc((size_t)maxn * npend * sizeof(int));
+    seen = (int*)malloc(maxn * sizeof(int));
+    owner = (int*)malloc((size_t)maxn * npend * sizeof(int));
+    left = (int*)malloc(maxn * sizeof(int));
+
+    if( 0 == rank )
+        printf("# %d procs, mode %s, %s, %d pending requests per communicator, %s\n",
+               np, mode_names[mode], split? "rows and columns": "duplicates",
+               npend, freereqs? "requests freed": "requests completed");
+
+    for(n = 10; n <= maxn; n *= 10) {
+        for(cy = 0; cy < cycles; cy++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            rss0 = rss();
+
+            start = MPI_Wtime();
+            for(i = 0; i < n; i++) {
+                if( !split || 0 == i )
+                    MPI_Comm_dup(MPI_COMM_WORLD, &comms[i]);
+                else if( i % 2 )
+                    MPI_Comm_split(MPI_COMM_WORLD, rank / rows, rank, &comms[i]);
+                else
+                    MPI_Comm_split(MPI_COMM_WORLD, rank % rows, rank, &comms[i]);
+                MPI_Comm_set_errhandler(comms[i], MPI_ERRORS_RETURN);
+                for(j = 0; j < npend; j++)
+                    MPI_Irecv(NULL, 0, MPI_BYTE, MPI_ANY_SOURCE, j, comms[i], &reqs[i*npend + j]);
+                seen[i] = 0;
+                left[i] = i;
+            }
+            for(k = 0; k < n * npend; k++) owner[k] = k / npend;
+            nact = n * npend;
+            nleft = n;
+            tcreate = MPI_Wtime() - start;
+            rss1 = rss();
+
+            MPI_Barrier(MPI_COMM_WORLD);
+            start = MPI_Wtime();
+            for(i = 0; i < n; i++) {
+                MPI_Comm_rank(comms[i], &crank);
+                MPI_Comm_size(comms[i], &csize);
+                if( (MODE_SINGLE == mode && 0 == crank) ||
+                    (MODE_CONCURRENT == mode && i % csize == crank) ||
+                    (MODE_CASCADE == mode && 0 == i && 0 == rank) )
+                    MPIX_Comm_revoke(comms[i]);
+            }
+            for(nseen = 0; nseen < n; ) {
+                if( freereqs ) {
+                    /* the requests are left pending: poll the communicators */
+                    MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+                    for(count = 0, k = 0; k < nleft; ) {
+                        MPIX_Comm_is_revoked(comms[left[k]], &flag);
+                        if( flag ) {
+                            indices[count++] = left[k];
+                            left[k] = left[--nleft];
+                        }
+                        else k++;
+                    }
+                }
+                else {
+                    MPI_Waitsome(nact, reqs, &count, indices, MPI_STATUSES_IGNORE);
+                    if( MPI_UNDEFINED == count ) break;
+                    /* the last pending request takes the place of each
+                     * completed one, from the highest place down */
+                    qsort(indices, count, sizeof(int), descending);
+                    for(j = 0; j < count; j++) {
+                        k = indices[j];
+                        indices[j] = owner[k];
+                        reqs[k] = reqs[--nact];
+                        owner[k] = owner[nact];
+                    }
+                }
+                for(j = 0; j < count; j++) {
+                    idx = indices[j];
+                    if( seen[idx]++ ) continue;
+                    nseen++;
+                    if( MODE_CASCADE == mode && 0 == idx ) {
+                        /* the world is revoked: revoke what we own */
+                        for(i = 1; i < n; i++) {
+                            MPI_Comm_rank(comms[i], &crank);
+                            if( 0 == crank ) MPIX_Comm_revoke(comms[i]);
+                        }
+                    }
+                }
+            }
+            trevoke = MPI_Wtime() - start;
+
+            start = MPI_Wtime();
+            for(i = 0; i < n; i++) {
+                if( freereqs ) {
+                    for(j = 0; j < npend; j++)
+                        if( MPI_REQUEST_NULL != reqs[i*npend + j] )
+                            MPI_Request_free(&reqs[i*npend + j]);
+                }
+                MPI_Comm_free(&comms[i]);
+            }
+            tfree = MPI_Wtime() - start;
+            MPI_Barrier(MPI_COMM_WORLD);
+            rss2 = rss();
+
+            t[0] = tcreate; t[1] = trevoke; t[2] = tfree;
+            MPI_Reduce(t, mt, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+            r[0] = rss1 - rss0; r[1] = rss1 - rss2; r[2] = rss2;
+            MPI_Reduce(r, mr, 3, MPI_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+            if( 0 == cy ) first = mr[2];
+            if( 0 == rank ) {
+                printf("REVOKEMANY %d communicators cycle %d: create %g s, revoke %g s (%g us per communicator), free %g s (%g us per communicator)\n",
+                       n, cy, mt[0], mt[1], mt[1] * 1e6 / n, mt[2], mt[2] * 1e6 / n);
+                printf("RSS %d communicators cycle %d: %ld kB to create, %ld kB reclaimed, %ld kB after, %ld kB more than after the first cycle\n",
+                       n, cy, mr[0], mr[1], mr[2], mr[2] - first);
+            }
+        }
+    }
+
+    free(comms); free(reqs); free(indices); free(seen); free(owner); free(left);
+    MPI_Finalize();
+
+    return 0;
+}
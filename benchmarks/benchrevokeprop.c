@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2012-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ *
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Propagation of MPIX_Comm_revoke: when does each rank see it?
+ *
+ * Each rank posts an MPI_Irecv that no send matches, and polls it: it
+ * completes with MPIX_ERR_REVOKED when the revoke reaches the rank. The
+ * clocks are corrected to the one of rank 0 (offset estimated by
+ * ping-pongs, keeping the shortest round trip), so the latency of a
+ * rank is the time it sees the revoke minus the time of the first
+ * revoke. The initiators (1, -k, and all the ranks) revoke at the same
+ * scheduled time. With traffic, every rank keeps -w messages of each
+ * size in flight with its ring neighbors while the revoke propagates.
+ *
+ * For each case, rank 0 prints the distribution of the latencies over
+ * all the ranks and repetitions, the number of traffic messages that
+ * completed on a rank between the revoke and its observation, and, with
+ * -p, the increase of that MPI_T counter (summed over the ranks), for
+ * instance the messages sent by the implementation.
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+
+#define SYNC_TAG     1
+#define DATA_TAG     2
+#define SENTINEL_TAG 3
+#define NPINGS       50
+
+static int rank, np;
+static double offset = 0.0; /* local clock - clock of rank 0 */
+
+/* ping-pongs with rank 0, the shortest one gives the offset */
+static void sync_clocks(void)
+{
+    double t0, t1, remote, best = 1e9, off = 0.0;
+    int r, i;
+
+    for(r = 1; r < np; r++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        for(i = 0; i < NPINGS; i++) {
+            if( 0 == rank ) {
+                t0 = MPI_Wtime();
+                MPI_Send(&t0, 1, MPI_DOUBLE, r, SYNC_TAG, MPI_COMM_WORLD);
+                MPI_Recv(&remote, 1, MPI_DOUBLE, r, SYNC_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                t1 = MPI_Wtime();
+                if( t1 - t0 < best ) {
+                    best = t1 - t0;
+                    off = remote - (t0 + t1) / 2.0;
+                }
+            }
+            else if( r == rank ) {
+                MPI_Recv(&t0, 1, MPI_DOUBLE, 0, SYNC_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                remote = MPI_Wtime();
+                MPI_Send(&remote, 1, MPI_DOUBLE, 0, SYNC_TAG, MPI_COMM_WORLD);
+            }
+        }
+        if( 0 == rank ) {
+            MPI_Send(&off, 1, MPI_DOUBLE, r, SYNC_TAG, MPI_COMM_WORLD);
+            best = 1e9;
+        }
+        else if( r == rank ) {
+            MPI_Recv(&offset, 1, MPI_DOUBLE, 0, SYNC_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+    }
+}
+
+static double now(void)
+{
+    return MPI_Wtime() - offset;
+}
+
+/* an MPI_T counter, read by name (-p) */
+static MPI_T_pvar_session pv_session;
+static MPI_T_pvar_handle pv_handle;
+static int pv_ok = 0;
+
+static void pvar_init(const char* name)
+{
+    int i, num, namelen, verbosity, varclass, bind, readonly, continuous, atomic, count, desclen;
+    char pname[256], desc[256];
+    MPI_Datatype type;
+    MPI_T_enum enumtype;
+
+    if( NULL == name ) return;
+    MPI_T_pvar_get_num(&num);
+    for(i = 0; i < num; i++) {
+        namelen = sizeof(pname); desclen = sizeof(desc);
+        MPI_T_pvar_get_info(i, pname, &namelen, &verbosity, &varclass, &type, &enumtype,
+                            desc, &desclen, &bind, &readonly, &continuous, &atomic);
+        if( strcmp(pname, name) ) continue;
+        if( MPI_T_BIND_NO_OBJECT != bind || MPI_UNSIGNED_LONG_LONG != type ) break;
+        MPI_T_pvar_session_create(&pv_session);
+        MPI_T_pvar_handle_alloc(pv_session, i, NULL, &pv_handle, &count);
+        if( !continuous ) MPI_T_pvar_start(pv_session, pv_handle);
+        pv_ok = (1 == count);
+        return;
+    }
+    if( 0 == rank ) fprintf(stderr, "# pvar %s not found (or not a global unsigned long long)\n", name);
+}
+
+static unsigned long long pvar_read(void)
+{
+    unsigned long long v = 0;
+    if( pv_ok ) MPI_T_pvar_read(pv_session, pv_handle, &v);
+    return v;
+}
+
+static int cmp_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x < y)? -1: (x > y);
+}
+
+/* one revoke: returns the latency of this rank, and the number of
+ * traffic messages completed while it propagated */
+static double revoke_once(int ninit, int size, int window, char* buf, int* inflight)
+{
+    MPI_Comm fcomm;
+    MPI_Request sentinel, *reqs = NULL;
+    double t_revoke = 1e30, t_first, t_seen = 0.0, at;
+    int i, flag, index, left, right, initiator, rc;
+
+    MPI_Comm_dup(MPI_COMM_WORLD, &fcomm);
+    MPI_Comm_set_errhandler(fcomm, MPI_ERRORS_RETURN);
+    left = (rank + np - 1) % np;
+    right = (rank + 1) % np;
+    MPI_Irecv(NULL, 0, MPI_BYTE, MPI_ANY_SOURCE, SENTINEL_TAG, fcomm, &sentinel);
+    if( 0 < size ) {
+        reqs = (MPI_Request*)malloc(2 * window * sizeof(MPI_Request));
+        for(i = 0; i < window; i++) {
+            MPI_Irecv(buf + (size_t)i * size, size, MPI_BYTE, left, DATA_TAG, fcomm, &reqs[2*i]);
+            MPI_Isend(buf + (size_t)(window + i) * size, size, MPI_BYTE, right, DATA_TAG, fcomm, &reqs[2*i+1]);
+        }
+    }
+    /* the initiators are spread over the ranks */
+    initiator = (rank % (np / ninit) == 0 && rank / (np / ninit) < ninit);
+
+    /* everybody is ready, and the revoke is scheduled 10ms from now */
+    MPI_Barrier(MPI_COMM_WORLD);
+    at = now() + 0.01;
+    MPI_Bcast(&at, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    *inflight = 0;
+    while( now() < at ) ;
+    if( initiator ) {
+        t_revoke = now();
+        MPIX_Comm_revoke(fcomm);
+    }
+    do {
+        rc = MPI_Test(&sentinel, &flag, MPI_STATUS_IGNORE);
+        if( flag || MPI_SUCCESS != rc ) {
+            t_seen = now();
+            break;
+        }
+        if( 0 < size ) {
+            /* keep the traffic going */
+            rc = MPI_Testany(2 * window, reqs, &index, &flag, MPI_STATUS_IGNORE);
+            if( MPI_SUCCESS == rc && flag && MPI_UNDEFINED != index ) {
+                (*inflight)++;
+                i = index / 2;
+                if( 0 == index % 2 )
+                    MPI_Irecv(buf + (size_t)i * size, size, MPI_BYTE, left, DATA_TAG, fcomm, &reqs[index]);
+                else
+                    MPI_Isend(buf + (size_t)(window + i) * size, size, MPI_BYTE, right, DATA_TAG, fcomm, &reqs[index]);
+            }
+        }
+    } while(1);
+
+    if( 0 < size ) {
+        /* they all complete in error now */
+        for(i = 0; i < 2 * window; i++) {
+            if( MPI_REQUEST_NULL != reqs[i] ) MPI_Wait(&reqs[i], MPI_STATUS_IGNORE);
+        }
+        free(reqs);
+    }
+    if( MPI_REQUEST_NULL != sentinel ) MPI_Wait(&sentinel, MPI_STATUS_IGNORE);
+    MPI_Comm_free(&fcomm);
+    MPI_Allreduce(&t_revoke, &t_first, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+    return t_seen - t_first;
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, r, s, k = 4, reps = 10, window = 16, maxsize = 1024*1024, traffic;
+    int ninit, ninits[3], inflight, total_inflight, size, provided;
+    const char* pvar = NULL;
+    double lat, *lats = NULL, *all = NULL, sum;
+    unsigned long long pv0, pv, pvsum;
+    char* buf;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+    while(1) {
+        static struct option long_options[] = {
+            { "initiators",   1, 0, 'k' },
+            { "repeat",       1, 0, 'r' },
+            { "window",       1, 0, 'w' },
+            { "max",          1, 0, 'M' },
+            { "pvar",         1, 0, 'p' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "k:r:w:M:p:", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 'k':
+            k = atoi(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'w':
+            window = atoi(optarg);
+            break;
+        case 'M':
+            maxsize = atoi(optarg);
+            break;
+        case 'p':
+            pvar = optarg;
+            break;
+        }
+    }
+    if( k < 1 || k > np ) k = (np < 4)? np: 4;
+    ninits[0] = 1; ninits[1] = k; ninits[2] = np;
+
+    MPI_T_init_thread(MPI_THREAD_SINGLE, &provided);
+    pvar_init(pvar);
+    sync_clocks();
+    buf = (char*)malloc(2 * (size_t)window * maxsize + 1);
+    lats = (double*)malloc(reps * sizeof(double));
+    if( 0 == rank ) all = (double*)malloc((size_t)reps * np * sizeof(double));
+
+    if( 0 == rank ) printf("# %d procs, %d repetitions, traffic window %d\n", np, reps, window);
+    for(c = 0; c < 3; c++) {
+        ninit = ninits[c];
+        if( c > 0 && ninit == ninits[c-1] ) continue;
+        /* size 0: no traffic */
+        for(traffic = 0, size = 0; size <= maxsize; size = (0 == size)? 8: size * 8, traffic = 1) {
+            total_inflight = 0;
+            pv0 = pvar_read();
+            for(r = 0; r < reps; r++) {
+                lats[r] = revoke_once(ninit, size, window, buf, &inflight);
+                total_inflight += inflight;
+            }
+            pv = pvar_read() - pv0;
+            MPI_Reduce(&pv, &pvsum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+            MPI_Reduce(&total_inflight, &i, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+            MPI_Gather(lats, reps, MPI_DOUBLE, all, reps, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+            if( 0 != rank ) continue;
+            qsort(all, (size_t)reps * np, sizeof(double), cmp_double);
+            for(sum = 0.0, s = 0; s < reps * np; s++) sum += all[s];
+            lat = sum / (reps * np);
+            printf("REVOKE %d initiators, %s %d bytes: latency us min %g median %g p90 %g p99 %g max %g mean %g",
+                   ninit, traffic? "traffic": "no traffic", size,
+                   all[0] * 1e6, all[reps*np/2] * 1e6, all[(int)(0.9*(reps*np-1))] * 1e6,
+                   all[(int)(0.99*(reps*np-1))] * 1e6, all[reps*np-1] * 1e6, lat * 1e6);
+            printf(", %g messages in flight per rank", (double)i / (reps * np));
+            if( pv_ok ) printf(", %s %g per revoke", pvar, (double)pvsum / reps);
+            printf("\n");
+        }
+    }
+
+    free(buf); free(lats); free(all);
+    if( pv_ok ) {
+        MPI_T_pvar_handle_free(pv_session, &pv_handle);
+        MPI_T_pvar_session_free(&pv_session);
+    }
+    MPI_T_finalize();
+    MPI_Finalize();
+
+    return 0;
+}
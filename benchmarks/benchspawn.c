@@ -0,0 +1,251 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Latency of MPI_Comm_spawn, as in a respawn recovery, against:
+ *  - the number of spawnees: 1, 2, 4... up to -n (32 by default, up to
+ *    1024 on a large enough allocation), from all the ranks;
+ *  - the size of the parent communicator: 1, 2, 4... ranks, spawning -s
+ *    processes (4 by default);
+ *  - concurrent spawns: the ranks are cut in 2, 4... disjoint groups,
+ *    each spawning -s processes at the same time.
+ * Each spawnee notes when its main starts, when MPI_Init and
+ * MPI_Comm_get_parent return, and when it receives the first message of
+ * the parents (sent as soon as MPI_Comm_spawn returns); reported from the
+ * beginning of the call, max over the spawnees. The spawnees and the
+ * parents compare gettimeofday clocks: across nodes, they have to be
+ * synchronized.
+ * With -f old, the last rank dies before the first spawn, and is
+ * acknowledged; every parent communicator includes it. With -f new, a
+ * parent dies right before each spawn, as in stress/spawn.c (each case
+ * costs a process, the last cases are not run with too few). With a
+ * failure, MPI_Comm_spawn may fail: FAILED is reported, and the time to
+ * the error.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include "../tutorial/ftfailed.h"
+
+#define F_NONE 0
+#define F_NEW  1
+#define F_OLD  2
+
+static const char* fault_names[3] = { "none", "new", "old" };
+
+#define C_SPAWNEES   0
+#define C_PARENTS    1
+#define C_CONCURRENT 2
+
+static const char* case_names[3] = { "spawnees", "parents", "concurrent" };
+
+#define MAX_CASES 64
+
+typedef struct {
+    int      type;
+    int      n;          /* spawnees per group */
+    int      p;          /* parents, 0 for all */
+    int      g;          /* groups */
+    int      na;         /* ranks alive at the beginning of the case */
+    MPI_Comm live;       /* the ranks alive at the beginning */
+    MPI_Comm surv;       /* the ranks alive after the failure (live without failure) */
+    MPI_Comm parents;    /* the group of this rank, if any */
+} case_t;
+
+/* wall clock, comparable between processes */
+static double wtime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/* the group of rank in the case, MPI_UNDEFINED if not a parent; the last
+ * alive rank, that dies with a failure, is always a parent */
+static int group(case_t* c, int rank)
+{
+    if( rank >= c->na ) return MPI_UNDEFINED;
+    switch(c->type) {
+    case C_PARENTS:
+        return (rank < c->p - 1 || rank == c->na - 1)? 0: MPI_UNDEFINED;
+    case C_CONCURRENT:
+        return rank * c->g / c->na;
+    default:
+        return 0;
+    }
+}
+
+static int spawnee(MPI_Comm parent, double tmain, double tinit, double tparent)
+{
+    double t0, d[4];
+
+    MPI_Comm_set_errhandler(parent, MPI_ERRORS_RETURN);
+    if( MPI_SUCCESS == MPI_Bcast(&t0, 1, MPI_DOUBLE, 0, parent) ) {
+        d[3] = wtime() - t0;
+        d[0] = tmain - t0;
+        d[1] = tinit - t0;
+        d[2] = tparent - t0;
+        MPI_Reduce(d, NULL, 4, MPI_DOUBLE, MPI_MAX, 0, parent);
+    }
+    MPI_Comm_disconnect(&parent);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
+
+int main( int argc, char* argv[] ) {
+    double tmain = wtime(), tinit, tparent;
+    MPI_Comm parent, icomm;
+    MPI_Group fgrp;
+    case_t cases[MAX_CASES], *c;
+    int rank, np, i, n, opt, rc, flag, prank, ncases = 0, fault = F_NONE, maxn = 32, nfix = 4;
+    double t0, t[5], maxt[5], d[4];
+    int ok, allok;
+
+    MPI_Init( &argc, &argv );
+    tinit = wtime();
+    MPI_Comm_get_parent( &parent );
+    tparent = wtime();
+    if( MPI_COMM_NULL != parent )
+        return spawnee(parent, tmain, tinit, tparent);
+
+    MPI_Comm_size( MPI_COMM_WORLD, &np );
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+    while(1) {
+        static struct option long_options[] = {
+            { "spawnees",     1, 0, 'n' },
+            { "size",         1, 0, 's' },
+            { "fault",        1, 0, 'f' },
+            { NULL,           0, 0, 0   }
+        };
+
+        opt = getopt_long(argc, argv, "n:s:f:", long_options, NULL);
+        if (opt == -1)
+            break;
+
+        switch(opt) {
+        case 'n':
+            maxn = atoi(optarg);
+            break;
+        case 's':
+            nfix = atoi(optarg);
+            break;
+        case 'f':
+            for(fault = F_OLD; fault > F_NONE && strcmp(optarg, fault_names[fault]); fault--);
+            break;
+        }
+    }
+
+    /* the cases, and their communicators, are set up before any failure */
+    for(n = 1; n <= maxn && ncases < MAX_CASES; n *= 2) {
+        cases[ncases].type = C_SPAWNEES; cases[ncases].n = n;
+        cases[ncases].p = 0; cases[ncases].g = 1; ncases++;
+    }
+    for(n = (F_NONE == fault)? 1: 2; n < np && ncases < MAX_CASES; n *= 2) {
+        cases[ncases].type = C_PARENTS; cases[ncases].n = nfix;
+        cases[ncases].p = n; cases[ncases].g = 1; ncases++;
+    }
+    for(n = 2; n <= np && ncases < MAX_CASES; n *= 2) {
+        cases[ncases].type = C_CONCURRENT; cases[ncases].n = nfix;
+        cases[ncases].p = 0; cases[ncases].g = n; ncases++;
+    }
+    for(i = 0; i < ncases; i++) {
+        c = &cases[i];
+        c->na = np - ((F_NEW == fault)? i: 0);
+        if( c->na < 2 || c->p > c->na || c->g > c->na - (F_NONE != fault) ) {
+            /* not enough ranks left */
+            ncases = i;
+            break;
+        }
+        MPI_Comm_split( MPI_COMM_WORLD, (rank < c->na - (F_OLD == fault))? 0: MPI_UNDEFINED, rank, &c->live );
+        MPI_Comm_split( MPI_COMM_WORLD, (rank < c->na - (F_NONE != fault))? 0: MPI_UNDEFINED, rank, &c->surv );
+        MPI_Comm_split( MPI_COMM_WORLD, group(c, rank), rank, &c->parents );
+        if( MPI_COMM_NULL != c->parents )
+            MPI_Comm_set_errhandler( c->parents, MPI_ERRORS_RETURN );
+    }
+
+    if( F_OLD == fault ) {
+        MPI_Comm_set_errhandler( MPI_COMM_WORLD, MPI_ERRORS_RETURN );
+        MPI_Barrier( MPI_COMM_WORLD );
+        if( rank == np - 1 ) {
+            raise(SIGKILL); do { pause(); } while(1);
+        }
+        /* until everybody knows */
+        flag = 1;
+        MPIX_Comm_agree( MPI_COMM_WORLD, &flag );
+    }
+
+    if( 0 == rank ) printf(
+        "## Case       Parents Groups Spawnees Fault # Spawn         # Main          # MPI_Init      # Get_parent    # First message # Status\n");
+
+    for(i = 0; i < ncases; i++) {
+        c = &cases[i];
+        MPI_Barrier( c->live );
+        if( F_NEW == fault && rank == c->na - 1 ) {
+            raise(SIGKILL); do { pause(); } while(1);
+        }
+
+        memset(t, 0, sizeof(t));
+        ok = 1;
+        if( MPI_COMM_NULL != c->parents ) {
+            if( F_OLD == fault ) {
+                ftf_ack_failed( c->parents, &fgrp );
+                ftf_group_free( &fgrp );
+            }
+            MPI_Comm_rank( c->parents, &prank );
+            t0 = wtime();
+            rc = MPI_Comm_spawn( argv[0], MPI_ARGV_NULL, c->n, MPI_INFO_NULL,
+                                 0, c->parents, &icomm, MPI_ERRCODES_IGNORE );
+            t[0] = wtime() - t0;
+            flag = (MPI_SUCCESS == rc);
+            MPIX_Comm_agree( c->parents, &flag );
+            if( flag ) {
+                MPI_Bcast( &t0, 1, MPI_DOUBLE, (0 == prank)? MPI_ROOT: MPI_PROC_NULL, icomm );
+                MPI_Reduce( NULL, d, 4, MPI_DOUBLE, MPI_MAX, (0 == prank)? MPI_ROOT: MPI_PROC_NULL, icomm );
+                if( 0 == prank ) memcpy(&t[1], d, sizeof(d));
+                MPI_Comm_disconnect( &icomm );
+            }
+            else {
+                if( MPI_SUCCESS == rc ) {
+                    MPIX_Comm_revoke( icomm );
+                    MPI_Comm_free( &icomm );
+                }
+                ok = 0;
+            }
+        }
+        MPI_Reduce( t, maxt, 5, MPI_DOUBLE, MPI_MAX, 0, c->surv );
+        MPI_Reduce( &ok, &allok, 1, MPI_INT, MPI_LAND, 0, c->surv );
+        if( 0 == rank )
+            printf("%-12s %7d %6d %8d %-5s # %13.5e # %13.5e # %13.5e # %13.5e # %13.5e # %s\n",
+                   case_names[c->type], (C_PARENTS == c->type)? c->p: c->na / c->g, c->g, c->n,
+                   fault_names[fault], maxt[0], maxt[1], maxt[2], maxt[3], maxt[4],
+                   allok? "OK": "FAILED");
+    }
+
+    for(i = 0; i < ncases; i++) {
+        c = &cases[i];
+        if( MPI_COMM_NULL != c->live ) MPI_Comm_free( &c->live );
+        if( MPI_COMM_NULL != c->surv ) MPI_Comm_free( &c->surv );
+        if( MPI_COMM_NULL != c->parents ) MPI_Comm_free( &c->parents );
+    }
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
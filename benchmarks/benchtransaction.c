@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2014-2017 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ *
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Cost of the TRY_BLOCK/CATCH_BLOCK transactions of the tutorial
+ * (13.transactions.c, libtran.h) against the amount of work they
+ * protect. Each transaction nests 'depth' blocks, one communicator per
+ * level, around a busy loop of 'g' microseconds, for g from --min to
+ * --max (doubling). For each g:
+ *  - FASTPATH: time per transaction without exception, and overhead
+ *    relative to the same work without blocks;
+ *  - EXCEPTION: time per transaction when --victim raises an exception
+ *    at the end of the block of level --raise (revoke, longjmp, and
+ *    the agreement of the catch part). Replacing the revoked
+ *    communicator (shrink) in the catch part is reported apart, as
+ *    REPAIR.
+ * THRESHOLD tells the smallest granularity from which the fast path
+ * overhead stays below 1%, 5% and 10%. Run at several -np to see how
+ * the communicator size matters. Times are the max over the ranks.
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <math.h>
+
+#include "../tutorial/libtran.h"
+
+static MPI_Comm* comms;
+static int depth = 3, raise_level = 0, victim = -1, rank;
+static double repair = 0.0;
+static MPI_Errhandler errh;
+
+static void work(double usec)
+{
+    double start = MPI_Wtime();
+    while( (MPI_Wtime() - start) * 1e6 < usec );
+}
+
+static void error_handler(MPI_Comm* pcomm, int* prc, ...)
+{
+    RAISE(*pcomm, 1);
+}
+
+/* the blocks of levels level..depth, around the work */
+static void transaction(int level, double usec, int raise)
+{
+    int exception;
+    double start;
+    MPI_Comm newcomm;
+
+    if( level > depth ) {
+        work(usec);
+        return;
+    }
+    TRY_BLOCK(comms[level], exception) {
+        transaction(level+1, usec, raise);
+        if( raise == level && rank == victim ) RAISE(comms[level], 2);
+    } CATCH_BLOCK(comms[level]) {
+        start = MPI_Wtime();
+        MPIX_Comm_shrink(comms[level], &newcomm);
+        MPI_Comm_free(&comms[level]);
+        comms[level] = newcomm;
+        MPI_Comm_set_errhandler(comms[level], errh);
+        repair += MPI_Wtime() - start;
+    } END_BLOCK()
+}
+
+int main(int argc, char *argv[])
+{
+    int size, c, i, l, n, nblocks = 100, ngran = 0;
+    double min = 1.0, max = 100000.0, g, start;
+    double base, fast, excp, rep, t;
+    double *grans, *overheads;
+    double thresholds[3] = { 1.0, 5.0, 10.0 };
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    while(1) {
+        static struct option long_options[] = {
+            { "depth",        1, 0, 'd' },
+            { "raise",        1, 0, 'r' },
+            { "victim",       1, 0, 'V' },
+            { "blocks",       1, 0, 'n' },
+            { "min",          1, 0, 'm' },
+            { "max",          1, 0, 'M' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "d:r:V:n:m:M:", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 'd':
+            depth = atoi(optarg);
+            break;
+        case 'r':
+            raise_level = atoi(optarg);
+            break;
+        case 'V':
+            victim = atoi(optarg);
+            break;
+        case 'n':
+            nblocks = atoi(optarg);
+            break;
+        case 'm':
+            min = atof(optarg);
+            break;
+        case 'M':
+            max = atof(optarg);
+            break;
+        }
+    }
+    if( 1 > depth ) depth = 1;
+    if( 1 > raise_level || raise_level > depth ) raise_level = depth;
+    if( 0 > victim || victim >= size ) victim = size-1;
+
+    libtran_init();
+    MPI_Comm_create_errhandler(error_handler, &errh);
+    comms = (MPI_Comm*)malloc((depth+1) * sizeof(MPI_Comm));
+    for(l = 1; l <= depth; l++) {
+        MPI_Comm_dup(MPI_COMM_WORLD, &comms[l]);
+        MPI_Comm_set_errhandler(comms[l], errh);
+    }
+    grans = (double*)malloc(64 * sizeof(double));
+    overheads = (double*)malloc(64 * sizeof(double));
+
+    /* warmup */
+    for(i = 0; i < 10; i++) transaction(1, 0.0, 0);
+
+    if( 0 == rank ) printf("# %d procs, depth %d, exception at level %d by rank %d\n",
+                           size, depth, raise_level, victim);
+    for(g = min; g <= max && ngran < 64; g *= 2.0) {
+        /* about 2 s per measure at most, same count on all ranks */
+        n = (int)fmax(10.0, fmin((double)nblocks, 2e6 / g));
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        start = MPI_Wtime();
+        for(i = 0; i < n; i++) work(g);
+        t = (MPI_Wtime() - start) / n;
+        MPI_Reduce(&t, &base, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        start = MPI_Wtime();
+        for(i = 0; i < n; i++) transaction(1, g, 0);
+        t = (MPI_Wtime() - start) / n;
+        MPI_Reduce(&t, &fast, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        repair = 0.0;
+        start = MPI_Wtime();
+        for(i = 0; i < n; i++) transaction(1, g, raise_level);
+        t = (MPI_Wtime() - start - repair) / n;
+        MPI_Reduce(&t, &excp, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        t = repair / n;
+        MPI_Reduce(&t, &rep, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+        if( 0 == rank ) {
+            grans[ngran] = g;
+            overheads[ngran] = 100.0 * (fast - base) / base;
+            printf("FASTPATH %g us granularity, %g us per transaction (work %g us), overhead %.3f %% (%g us per block)\n",
+                   g, fast * 1e6, base * 1e6, overheads[ngran], (fast - base) * 1e6 / depth);
+            printf("EXCEPTION %g us granularity, %g us per transaction, %g us over the fast path\n",
+                   g, excp * 1e6, (excp - fast) * 1e6);
+            printf("REPAIR %g us granularity, %g us per transaction\n", g, rep * 1e6);
+        }
+        ngran++;
+    }
+
+    if( 0 == rank && 0 < ngran ) {
+        for(c = 0; c < 3; c++) {
+            /* the smallest granularity from which all are below */
+            for(i = ngran-1; i >= 0 && overheads[i] < thresholds[c]; i--);
+            if( i == ngran-1 )
+                printf("THRESHOLD %g %% not reached up to %g us\n", thresholds[c], grans[ngran-1]);
+            else
+                printf("THRESHOLD %g %% from %g us granularity\n", thresholds[c], grans[i+1]);
+        }
+    }
+
+    for(l = 1; l <= depth; l++) MPI_Comm_free(&comms[l]);
+    MPI_Errhandler_free(&errh);
+    free(comms); free(grans); free(overheads);
+    libtran_fini();
+    MPI_Finalize();
+
+    return 0;
+}
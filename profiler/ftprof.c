@@ -0,0 +1,594 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Profiling of the fault tolerance calls of an unmodified application,
+ * through the PMPI interface: LD_PRELOAD=libftprof.so mpiexec ... (C
+ * bindings only). Counted and timed, per communicator: MPIX_Comm_agree,
+ * MPIX_Comm_iagree and MPIX_Comm_ishrink (from the call to the
+ * completion, when the thread that posted it sees it with any of the
+ * MPI_Wait and MPI_Test functions),
+ * MPIX_Comm_shrink, MPIX_Comm_revoke, MPIX_Comm_failure_ack,
+ * MPIX_Comm_failure_get_acked, MPIX_Comm_get_failed and
+ * MPIX_Comm_ack_failed (when the library has them), MPI_Comm_spawn,
+ * MPI_Intercomm_merge, and the error handlers created with
+ * MPI_Comm_create_errhandler. For each: the calls, those that returned an
+ * error, the total and max time, and a histogram of the durations (1us,
+ * 2us, 4us...). Some calls are counted without a duration: the error
+ * handlers that do not return (longjmp), and the nonblocking operations
+ * beyond FTPROF_MAX_PENDING in flight, or freed before completion.
+ * Each thread records in its own buffer, without lock; the buffers are
+ * put together at MPI_Finalize. Then the survivors of MPI_COMM_WORLD
+ * (shrunk) sum them up, and rank 0 prints a summary by operation. With
+ * FTPROF_OUTPUT=prefix, each rank also writes the details per
+ * communicator in prefix.<rank>. Communicators get an id when first seen
+ * (the same communicator may have different ids on different ranks);
+ * beyond FTPROF_MAX_COMMS, they are counted together as "others".
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define FTPROF_MAX_COMMS    64
+#define FTPROF_MAX_PENDING  16
+#define FTPROF_MAX_EH       16
+#define NB_BUCKETS          24
+
+#if defined(OMPI_HAVE_MPIX_COMM_GET_FAILED) && OMPI_HAVE_MPIX_COMM_GET_FAILED
+#define FTPROF_GET_FAILED 1
+#else
+#define FTPROF_GET_FAILED 0
+#endif
+
+enum {
+    OP_AGREE, OP_IAGREE, OP_SHRINK, OP_ISHRINK, OP_REVOKE,
+    OP_FAILURE_ACK, OP_FAILURE_GET_ACKED, OP_GET_FAILED, OP_ACK_FAILED,
+    OP_SPAWN, OP_INTERCOMM_MERGE, OP_ERRHANDLER, NB_OPS
+};
+
+static const char* op_names[NB_OPS] = {
+    "Comm_agree", "Comm_iagree", "Comm_shrink", "Comm_ishrink", "Comm_revoke",
+    "Comm_failure_ack", "Comm_failure_get_acked", "Comm_get_failed", "Comm_ack_failed",
+    "Comm_spawn", "Intercomm_merge", "errhandler"
+};
+
+typedef struct {
+    long   count;
+    long   errors;
+    double total;
+    double max;
+    long   hist[NB_BUCKETS];
+} ftprof_stat_t;
+
+typedef struct {
+    MPI_Request req;
+    int         op;
+    int         id;
+    double      start;
+} ftprof_pending_t;
+
+typedef struct ftprof_buf_s {
+    struct ftprof_buf_s* next;
+    ftprof_stat_t        stats[FTPROF_MAX_COMMS][NB_OPS];
+    int                  npending;
+    ftprof_pending_t     pending[FTPROF_MAX_PENDING];
+} ftprof_buf_t;
+
+typedef struct {
+    int  size;
+    int  inter;
+    char name[MPI_MAX_OBJECT_NAME];
+} ftprof_comm_t;
+
+static ftprof_buf_t* ftprof_bufs = NULL;      /* all the threads' buffers */
+static __thread ftprof_buf_t* ftprof_buf = NULL;
+static ftprof_comm_t ftprof_comms[FTPROF_MAX_COMMS];
+static int ftprof_ncomms = 1;                  /* id 0 is "others" */
+static int ftprof_keyval = MPI_KEYVAL_INVALID;
+static pthread_once_t ftprof_once = PTHREAD_ONCE_INIT;
+
+static MPI_Comm_errhandler_function* ftprof_eh_fns[FTPROF_MAX_EH];
+static int ftprof_neh = 0;
+
+static ftprof_buf_t* ftprof_get_buf(void)
+{
+    ftprof_buf_t* buf = ftprof_buf;
+
+    if( NULL == buf ) {
+        buf = (ftprof_buf_t*)calloc(1, sizeof(ftprof_buf_t));
+        buf->next = __atomic_load_n(&ftprof_bufs, __ATOMIC_ACQUIRE);
+        while( !__atomic_compare_exchange_n(&ftprof_bufs, &buf->next, buf, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_ACQUIRE) );
+        ftprof_buf = buf;
+    }
+    return buf;
+}
+
+static void ftprof_create_keyval(void)
+{
+    PMPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, MPI_COMM_NULL_DELETE_FN,
+                            &ftprof_keyval, NULL);
+}
+
+/* the id of comm, given the first time it is seen */
+static int ftprof_comm_id(MPI_Comm comm)
+{
+    void* attr;
+    int flag, id;
+
+    if( MPI_COMM_NULL == comm ) return 0;
+    pthread_once(&ftprof_once, ftprof_create_keyval);
+    PMPI_Comm_get_attr(comm, ftprof_keyval, &attr, &flag);
+    if( flag ) return (int)(intptr_t)attr;
+    id = __atomic_fetch_add(&ftprof_ncomms, 1, __ATOMIC_RELAXED);
+    if( id >= FTPROF_MAX_COMMS ) {
+        id = 0;
+    }
+    else {
+        PMPI_Comm_test_inter(comm, &ftprof_comms[id].inter);
+        if( ftprof_comms[id].inter ) PMPI_Comm_remote_size(comm, &ftprof_comms[id].size);
+        else PMPI_Comm_size(comm, &ftprof_comms[id].size);
+        PMPI_Comm_get_name(comm, ftprof_comms[id].name, &flag);
+    }
+    PMPI_Comm_set_attr(comm, ftprof_keyval, (void*)(intptr_t)id);
+    return id;
+}
+
+/* the call, and then its duration: a call may be counted without a
+ * duration (error handler that does not return, full pending table) */
+static void ftprof_count(int id, int op, int rc)
+{
+    ftprof_stat_t* s = &ftprof_get_buf()->stats[id][op];
+
+    s->count++;
+    if( MPI_SUCCESS != rc ) s->errors++;
+}
+
+static void ftprof_time(int id, int op, double t)
+{
+    ftprof_stat_t* s = &ftprof_get_buf()->stats[id][op];
+    double us = t * 1e6;
+    int b = 0;
+
+    s->total += t;
+    if( t > s->max ) s->max = t;
+    while( us >= 2.0 && b < NB_BUCKETS - 1 ) {
+        us /= 2.0;
+        b++;
+    }
+    s->hist[b]++;
+}
+
+static void ftprof_record(int id, int op, int rc, double t)
+{
+    ftprof_count(id, op, rc);
+    ftprof_time(id, op, t);
+}
+
+static int ftprof_find(MPI_Request req)
+{
+    ftprof_buf_t* buf = ftprof_buf;
+    int i;
+
+    for( i = 0; i < buf->npending; i++ )
+        if( buf->pending[i].req == req ) return i;
+    return -1;
+}
+
+static void ftprof_drop(int i)
+{
+    ftprof_buf_t* buf = ftprof_buf;
+
+    buf->pending[i] = buf->pending[--buf->npending];
+}
+
+/* nonblocking operations: timed until their completion is seen */
+static void ftprof_post(int id, int op, MPI_Request req, double start)
+{
+    ftprof_buf_t* buf = ftprof_get_buf();
+    int i;
+
+    /* a handle completed where we did not see it, now reused */
+    if( 0 <= (i = ftprof_find(req)) ) {
+        ftprof_count(buf->pending[i].id, buf->pending[i].op, MPI_SUCCESS);
+        ftprof_drop(i);
+    }
+    if( buf->npending == FTPROF_MAX_PENDING ) {
+        ftprof_count(id, op, MPI_SUCCESS);
+        return;
+    }
+    buf->pending[buf->npending].req = req;
+    buf->pending[buf->npending].op = op;
+    buf->pending[buf->npending].id = id;
+    buf->pending[buf->npending].start = start;
+    buf->npending++;
+}
+
+static void ftprof_complete(MPI_Request req, int rc, double now)
+{
+    ftprof_buf_t* buf = ftprof_buf;
+    int i = ftprof_find(req);
+
+    if( i < 0 ) return;
+    ftprof_record(buf->pending[i].id, buf->pending[i].op, rc, now - buf->pending[i].start);
+    ftprof_drop(i);
+}
+
+/* before a completion on an array: where the pending requests are in it
+ * (the completed handles are reset); at most FTPROF_MAX_PENDING */
+static int ftprof_locate(int count, MPI_Request reqs[], int* pos, MPI_Request* r)
+{
+    int i, n = 0;
+
+    if( NULL == ftprof_buf || 0 == ftprof_buf->npending ) return 0;
+    for( i = 0; i < count && n < ftprof_buf->npending; i++ ) {
+        if( MPI_REQUEST_NULL == reqs[i] || ftprof_find(reqs[i]) < 0 ) continue;
+        pos[n] = i;
+        r[n++] = reqs[i];
+    }
+    return n;
+}
+
+/* after: the located requests completed at indices[0..outcount) */
+static void ftprof_complete_some(int n, int* pos, MPI_Request* r, int outcount,
+                                 int* indices, MPI_Status* statuses, int rc)
+{
+    double now = PMPI_Wtime();
+    int j, k, erc;
+
+    for( j = 0; j < n; j++ ) {
+        for( k = 0; k < outcount && indices[k] != pos[j]; k++ );
+        if( k == outcount ) continue;
+        erc = rc;
+        if( MPI_ERR_IN_STATUS == rc && MPI_STATUSES_IGNORE != statuses )
+            erc = statuses[k].MPI_ERROR;
+        ftprof_complete(r[j], erc, now);
+    }
+}
+
+/* after: the located requests whose handle was reset completed (with
+ * an error, the others may still be pending); statuses by position */
+static void ftprof_complete_all(int n, int* pos, MPI_Request* r, MPI_Request reqs[],
+                                MPI_Status* statuses, int rc)
+{
+    double now = PMPI_Wtime();
+    int j, erc;
+
+    for( j = 0; j < n; j++ ) {
+        if( MPI_REQUEST_NULL != reqs[pos[j]] ) continue;
+        erc = rc;
+        if( MPI_ERR_IN_STATUS == rc && MPI_STATUSES_IGNORE != statuses )
+            erc = statuses[pos[j]].MPI_ERROR;
+        ftprof_complete(r[j], erc, now);
+    }
+}
+
+#define FTPROF_TIMED(op, comm, call)                        \
+    do {                                                    \
+        int id = ftprof_comm_id(comm), rc;                  \
+        double start = PMPI_Wtime();                        \
+        rc = call;                                          \
+        ftprof_record(id, op, rc, PMPI_Wtime() - start);    \
+        return rc;                                          \
+    } while(0)
+
+int MPIX_Comm_agree(MPI_Comm comm, int* flag)
+{
+    FTPROF_TIMED(OP_AGREE, comm, PMPIX_Comm_agree(comm, flag));
+}
+
+int MPIX_Comm_shrink(MPI_Comm comm, MPI_Comm* newcomm)
+{
+    FTPROF_TIMED(OP_SHRINK, comm, PMPIX_Comm_shrink(comm, newcomm));
+}
+
+int MPIX_Comm_revoke(MPI_Comm comm)
+{
+    FTPROF_TIMED(OP_REVOKE, comm, PMPIX_Comm_revoke(comm));
+}
+
+int MPIX_Comm_failure_ack(MPI_Comm comm)
+{
+    FTPROF_TIMED(OP_FAILURE_ACK, comm, PMPIX_Comm_failure_ack(comm));
+}
+
+int MPIX_Comm_failure_get_acked(MPI_Comm comm, MPI_Group* failed)
+{
+    FTPROF_TIMED(OP_FAILURE_GET_ACKED, comm, PMPIX_Comm_failure_get_acked(comm, failed));
+}
+
+#if FTPROF_GET_FAILED
+int MPIX_Comm_get_failed(MPI_Comm comm, MPI_Group* failed)
+{
+    FTPROF_TIMED(OP_GET_FAILED, comm, PMPIX_Comm_get_failed(comm, failed));
+}
+
+int MPIX_Comm_ack_failed(MPI_Comm comm, int num_to_ack, int* num_acked)
+{
+    FTPROF_TIMED(OP_ACK_FAILED, comm, PMPIX_Comm_ack_failed(comm, num_to_ack, num_acked));
+}
+#endif  /* FTPROF_GET_FAILED */
+
+int MPI_Comm_spawn(const char* command, char* argv[], int maxprocs, MPI_Info info,
+                   int root, MPI_Comm comm, MPI_Comm* intercomm, int array_of_errcodes[])
+{
+    FTPROF_TIMED(OP_SPAWN, comm, PMPI_Comm_spawn(command, argv, maxprocs, info, root,
+                                                 comm, intercomm, array_of_errcodes));
+}
+
+int MPI_Intercomm_merge(MPI_Comm intercomm, int high, MPI_Comm* newintracomm)
+{
+    FTPROF_TIMED(OP_INTERCOMM_MERGE, intercomm, PMPI_Intercomm_merge(intercomm, high, newintracomm));
+}
+
+int MPIX_Comm_iagree(MPI_Comm comm, int* flag, MPI_Request* req)
+{
+    int id = ftprof_comm_id(comm), rc;
+    double start = PMPI_Wtime();
+
+    rc = PMPIX_Comm_iagree(comm, flag, req);
+    if( MPI_SUCCESS == rc ) ftprof_post(id, OP_IAGREE, *req, start);
+    else ftprof_record(id, OP_IAGREE, rc, PMPI_Wtime() - start);
+    return rc;
+}
+
+int MPIX_Comm_ishrink(MPI_Comm comm, MPI_Comm* newcomm, MPI_Request* req)
+{
+    int id = ftprof_comm_id(comm), rc;
+    double start = PMPI_Wtime();
+
+    rc = PMPIX_Comm_ishrink(comm, newcomm, req);
+    if( MPI_SUCCESS == rc ) ftprof_post(id, OP_ISHRINK, *req, start);
+    else ftprof_record(id, OP_ISHRINK, rc, PMPI_Wtime() - start);
+    return rc;
+}
+
+/* the completions, only looked at when this thread has posted some */
+int MPI_Wait(MPI_Request* req, MPI_Status* status)
+{
+    MPI_Request r = *req;
+    int rc;
+
+    rc = PMPI_Wait(req, status);
+    if( NULL != ftprof_buf && ftprof_buf->npending )
+        ftprof_complete(r, rc, PMPI_Wtime());
+    return rc;
+}
+
+int MPI_Test(MPI_Request* req, int* flag, MPI_Status* status)
+{
+    MPI_Request r = *req;
+    int rc;
+
+    rc = PMPI_Test(req, flag, status);
+    if( NULL != ftprof_buf && ftprof_buf->npending && *flag )
+        ftprof_complete(r, rc, PMPI_Wtime());
+    return rc;
+}
+
+int MPI_Waitall(int count, MPI_Request reqs[], MPI_Status statuses[])
+{
+    MPI_Request r[FTPROF_MAX_PENDING];
+    int pos[FTPROF_MAX_PENDING], n, rc;
+
+    n = ftprof_locate(count, reqs, pos, r);
+    rc = PMPI_Waitall(count, reqs, statuses);
+    if( n ) ftprof_complete_all(n, pos, r, reqs, statuses, rc);
+    return rc;
+}
+
+int MPI_Testall(int count, MPI_Request reqs[], int* flag, MPI_Status statuses[])
+{
+    MPI_Request r[FTPROF_MAX_PENDING];
+    int pos[FTPROF_MAX_PENDING], n, rc;
+
+    n = ftprof_locate(count, reqs, pos, r);
+    rc = PMPI_Testall(count, reqs, flag, statuses);
+    if( n ) ftprof_complete_all(n, pos, r, reqs, statuses, rc);
+    return rc;
+}
+
+int MPI_Waitany(int count, MPI_Request reqs[], int* index, MPI_Status* status)
+{
+    MPI_Request r[FTPROF_MAX_PENDING];
+    int pos[FTPROF_MAX_PENDING], n, rc;
+
+    n = ftprof_locate(count, reqs, pos, r);
+    rc = PMPI_Waitany(count, reqs, index, status);
+    if( n && MPI_UNDEFINED != *index ) ftprof_complete_some(n, pos, r, 1, index, NULL, rc);
+    return rc;
+}
+
+int MPI_Testany(int count, MPI_Request reqs[], int* index, int* flag, MPI_Status* status)
+{
+    MPI_Request r[FTPROF_MAX_PENDING];
+    int pos[FTPROF_MAX_PENDING], n, rc;
+
+    n = ftprof_locate(count, reqs, pos, r);
+    rc = PMPI_Testany(count, reqs, index, flag, status);
+    if( n && *flag && MPI_UNDEFINED != *index ) ftprof_complete_some(n, pos, r, 1, index, NULL, rc);
+    return rc;
+}
+
+int MPI_Waitsome(int incount, MPI_Request reqs[], int* outcount, int indices[],
+                 MPI_Status statuses[])
+{
+    MPI_Request r[FTPROF_MAX_PENDING];
+    int pos[FTPROF_MAX_PENDING], n, rc;
+
+    n = ftprof_locate(incount, reqs, pos, r);
+    rc = PMPI_Waitsome(incount, reqs, outcount, indices, statuses);
+    if( n && MPI_UNDEFINED != *outcount )
+        ftprof_complete_some(n, pos, r, *outcount, indices, statuses, rc);
+    return rc;
+}
+
+int MPI_Testsome(int incount, MPI_Request reqs[], int* outcount, int indices[],
+                 MPI_Status statuses[])
+{
+    MPI_Request r[FTPROF_MAX_PENDING];
+    int pos[FTPROF_MAX_PENDING], n, rc;
+
+    n = ftprof_locate(incount, reqs, pos, r);
+    rc = PMPI_Testsome(incount, reqs, outcount, indices, statuses);
+    if( n && MPI_UNDEFINED != *outcount )
+        ftprof_complete_some(n, pos, r, *outcount, indices, statuses, rc);
+    return rc;
+}
+
+/* a request freed before its completion is seen: counted, not timed */
+int MPI_Request_free(MPI_Request* req)
+{
+    int i;
+
+    if( NULL != ftprof_buf && ftprof_buf->npending && 0 <= (i = ftprof_find(*req)) ) {
+        ftprof_count(ftprof_buf->pending[i].id, ftprof_buf->pending[i].op, MPI_SUCCESS);
+        ftprof_drop(i);
+    }
+    return PMPI_Request_free(req);
+}
+
+/* error handlers: each function given to MPI_Comm_create_errhandler is
+ * called through one of these */
+static void ftprof_errhandler(int slot, MPI_Comm* comm, int* err)
+{
+    int id = ftprof_comm_id(*comm);
+    double start = PMPI_Wtime();
+
+    /* counted first: the handler may longjmp out */
+    ftprof_count(id, OP_ERRHANDLER, *err);
+    ftprof_eh_fns[slot](comm, err);
+    ftprof_time(id, OP_ERRHANDLER, PMPI_Wtime() - start);
+}
+
+#define FTPROF_EH(i) \
+    static void ftprof_eh##i(MPI_Comm* comm, int* err, ...) { ftprof_errhandler(i, comm, err); }
+FTPROF_EH(0)  FTPROF_EH(1)  FTPROF_EH(2)  FTPROF_EH(3)
+FTPROF_EH(4)  FTPROF_EH(5)  FTPROF_EH(6)  FTPROF_EH(7)
+FTPROF_EH(8)  FTPROF_EH(9)  FTPROF_EH(10) FTPROF_EH(11)
+FTPROF_EH(12) FTPROF_EH(13) FTPROF_EH(14) FTPROF_EH(15)
+
+static MPI_Comm_errhandler_function* ftprof_ehs[FTPROF_MAX_EH] = {
+    ftprof_eh0,  ftprof_eh1,  ftprof_eh2,  ftprof_eh3,
+    ftprof_eh4,  ftprof_eh5,  ftprof_eh6,  ftprof_eh7,
+    ftprof_eh8,  ftprof_eh9,  ftprof_eh10, ftprof_eh11,
+    ftprof_eh12, ftprof_eh13, ftprof_eh14, ftprof_eh15
+};
+
+int MPI_Comm_create_errhandler(MPI_Comm_errhandler_function* fn, MPI_Errhandler* errh)
+{
+    int slot = __atomic_fetch_add(&ftprof_neh, 1, __ATOMIC_RELAXED);
+
+    if( slot >= FTPROF_MAX_EH )
+        return PMPI_Comm_create_errhandler(fn, errh);
+    ftprof_eh_fns[slot] = fn;
+    return PMPI_Comm_create_errhandler(ftprof_ehs[slot], errh);
+}
+
+static void ftprof_print_hist(FILE* f, long* hist)
+{
+    int b;
+
+    for( b = 0; b < NB_BUCKETS; b++ )
+        if( hist[b] ) fprintf(f, " [%ldus]=%ld", 1L << b, hist[b]);
+    fprintf(f, "\n");
+}
+
+int MPI_Finalize(void)
+{
+    static ftprof_stat_t all[FTPROF_MAX_COMMS][NB_OPS];
+    ftprof_stat_t *s, *a;
+    long counts[NB_OPS][2 + NB_BUCKETS], sumc[NB_OPS][2 + NB_BUCKETS];
+    double times[NB_OPS][2], sumt[NB_OPS][2], maxt[NB_OPS][2];
+    ftprof_buf_t* buf;
+    MPI_Comm scomm;
+    char* prefix = getenv("FTPROF_OUTPUT");
+    char fname[1024];
+    FILE* f;
+    int wrank, rank, id, op, b, ncomms;
+
+    /* the threads' buffers, together */
+    memset(all, 0, sizeof(all));
+    for( buf = ftprof_bufs; NULL != buf; buf = buf->next ) {
+        for( id = 0; id < FTPROF_MAX_COMMS; id++ ) {
+            for( op = 0; op < NB_OPS; op++ ) {
+                s = &buf->stats[id][op];
+                a = &all[id][op];
+                a->count += s->count;
+                a->errors += s->errors;
+                a->total += s->total;
+                if( s->max > a->max ) a->max = s->max;
+                for( b = 0; b < NB_BUCKETS; b++ ) a->hist[b] += s->hist[b];
+            }
+        }
+    }
+
+    PMPI_Comm_rank(MPI_COMM_WORLD, &wrank);
+    ncomms = (ftprof_ncomms < FTPROF_MAX_COMMS)? ftprof_ncomms: FTPROF_MAX_COMMS;
+    if( NULL != prefix ) {
+        snprintf(fname, sizeof(fname), "%s.%d", prefix, wrank);
+        if( NULL != (f = fopen(fname, "w")) ) {
+            for( id = 0; id < ncomms; id++ ) {
+                for( op = 0; op < NB_OPS; op++ ) {
+                    a = &all[id][op];
+                    if( 0 == a->count ) continue;
+                    fprintf(f, "FTPROF comm %d (%s%s, %d procs) %-22s calls %ld errors %ld total %g s max %g s:",
+                            id, id? ftprof_comms[id].name: "others",
+                            (id && ftprof_comms[id].inter)? " inter": "",
+                            id? ftprof_comms[id].size: 0, op_names[op],
+                            a->count, a->errors, a->total, a->max);
+                    ftprof_print_hist(f, a->hist);
+                }
+            }
+            fclose(f);
+        }
+    }
+
+    /* the summary, over all communicators and the surviving ranks */
+    memset(counts, 0, sizeof(counts));
+    memset(times, 0, sizeof(times));
+    for( op = 0; op < NB_OPS; op++ ) {
+        for( id = 0; id < ncomms; id++ ) {
+            a = &all[id][op];
+            counts[op][0] += a->count;
+            counts[op][1] += a->errors;
+            for( b = 0; b < NB_BUCKETS; b++ ) counts[op][2 + b] += a->hist[b];
+            times[op][0] += a->total;
+            if( a->max > times[op][1] ) times[op][1] = a->max;
+        }
+    }
+    PMPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+    if( MPI_SUCCESS == PMPIX_Comm_shrink(MPI_COMM_WORLD, &scomm) ) {
+        PMPI_Comm_set_errhandler(scomm, MPI_ERRORS_RETURN);
+        PMPI_Comm_rank(scomm, &rank);
+        PMPI_Reduce(counts, sumc, NB_OPS * (2 + NB_BUCKETS), MPI_LONG, MPI_SUM, 0, scomm);
+        PMPI_Reduce(times, sumt, NB_OPS * 2, MPI_DOUBLE, MPI_SUM, 0, scomm);
+        PMPI_Reduce(times, maxt, NB_OPS * 2, MPI_DOUBLE, MPI_MAX, 0, scomm);
+        if( 0 == rank ) {
+            for( op = 0; op < NB_OPS; op++ ) {
+                if( 0 == sumc[op][0] ) continue;
+                printf("FTPROF %-22s calls %ld errors %ld total %g s (max per rank %g s) max %g s:",
+                       op_names[op], sumc[op][0], sumc[op][1], sumt[op][0], maxt[op][0], maxt[op][1]);
+                ftprof_print_hist(stdout, sumc[op] + 2);
+            }
+            fflush(stdout);
+        }
+        PMPI_Comm_free(&scomm);
+    }
+
+    return PMPI_Finalize();
+}
@@ -21,6 +21,10 @@
 #include <signal.h>
 #include <unistd.h>
 
+#include "../tutorial/ftfailed.h"
+
+static void verbose_errhandler(MPI_Comm* pcomm, int* perr, ...);
+
 int main(int argc, char *argv[]) {
     int rank, size;
     MPI_Errhandler errh;
@@ -72,9 +76,8 @@ static void verbose_errhandler(MPI_Comm* pcomm, int* perr, ...) {
     MPI_Comm comm = *pcomm;
     int err = *perr;
     char errstr[MPI_MAX_ERROR_STRING];
-    int i, rank, size, nf, len, eclass;
-    MPI_Group group_c, group_f;
-    int *ranks_gc, *ranks_gf;
+    int i, rank, size, nnew, len, eclass;
+    ftf_cache_t* fc;
 
     MPI_Error_class(err, &eclass);
     if( MPIX_ERR_PROC_FAILED != eclass ) {
@@ -84,29 +87,15 @@ static void verbose_errhandler(MPI_Comm* pcomm, int* perr, ...) {
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &size);
 
-    /* We use a combination of 'ack/get_acked' to obtain the list of 
-     * failed processes (as seen by the local rank). 
+    /* We acknowledge the failures, and the failure cache of 'comm'
+     * gives the ranks of the new ones (as seen by the local rank).
      */
-    MPIX_Comm_failure_ack(comm);
-    MPIX_Comm_failure_get_acked(comm, &group_f);
-    MPI_Group_size(group_f, &nf);
+    nnew = ftf_cache_update(comm, &fc);
     MPI_Error_string(err, errstr, &len);
-    printf("Rank %d / %d: Notified of error %s. %d found dead: { ",
-           rank, size, errstr, nf);
-
-    /* We use 'translate_ranks' to obtain the ranks of failed procs 
-     * in the input communicator 'comm'.
-     */
-    ranks_gf = (int*)malloc(nf * sizeof(int));
-    ranks_gc = (int*)malloc(nf * sizeof(int));
-    MPI_Comm_group(comm, &group_c);
-    for(i = 0; i < nf; i++)
-        ranks_gf[i] = i;
-    MPI_Group_translate_ranks(group_f, nf, ranks_gf,
-                              group_c, ranks_gc);
-    for(i = 0; i < nf; i++)
-        printf("%d ", ranks_gc[i]);
+    printf("Rank %d / %d: Notified of error %s. %d found dead, %d new: { ",
+           rank, size, errstr, fc->nf, nnew);
+    for(i = fc->nf - nnew; i < fc->nf; i++)
+        printf("%d ", fc->ranks[i]);
     printf("}\n");
-    free(ranks_gf); free(ranks_gc);
 }
 
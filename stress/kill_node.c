@@ -26,6 +26,8 @@
 #include <unistd.h>
 #include <signal.h>
 
+#include "../tutorial/ftfailed.h"
+
 static void verbose_errhandler(MPI_Comm* pcomm, int* perr, ...);
 
 int main(int argc, char *argv[]) {
@@ -82,9 +84,8 @@ static void verbose_errhandler(MPI_Comm* pcomm, int* perr, ...) {
     MPI_Comm comm = *pcomm;
     int err = *perr;
     char errstr[MPI_MAX_ERROR_STRING];
-    int i, rank, wrank, size, nf, len, eclass;
-    MPI_Group group_c, group_f;
-    int *ranks_gc, *ranks_gf;
+    int i, rank, wrank, size, nnew, len, eclass;
+    ftf_cache_t* fc;
 
     MPI_Error_class(err, &eclass);
     if( MPIX_ERR_PROC_FAILED != eclass ) {
@@ -95,23 +96,13 @@ static void verbose_errhandler(MPI_Comm* pcomm, int* perr, ...) {
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &size);
 
-    MPIX_Comm_failure_ack(comm);
-    MPIX_Comm_failure_get_acked(comm, &group_f);
-    MPI_Group_size(group_f, &nf);
+    nnew = ftf_cache_update(comm, &fc);
     MPI_Error_string(err, errstr, &len);
-    printf("Rank %02d (%02d/%d): Notified of error %s. %d found dead in %s: { ",
-           wrank, rank, size, errstr, nf, MPI_COMM_WORLD==comm? "comm_world": "comm_split_shared");
-
-    ranks_gf = (int*)malloc(nf * sizeof(int));
-    ranks_gc = (int*)malloc(nf * sizeof(int));
-    MPI_Comm_group(comm, &group_c);
-    for(i = 0; i < nf; i++)
-        ranks_gf[i] = i;
-    MPI_Group_translate_ranks(group_f, nf, ranks_gf,
-                              group_c, ranks_gc);
-    for(i = 0; i < nf; i++) {
-        printf("%d ", ranks_gc[i]);
-        if(MPI_PROC_NULL == ranks_gc[i]) {
+    printf("Rank %02d (%02d/%d): Notified of error %s. %d found dead in %s, %d new: { ",
+           wrank, rank, size, errstr, fc->nf, MPI_COMM_WORLD==comm? "comm_world": "comm_split_shared", nnew);
+    for(i = fc->nf - nnew; i < fc->nf; i++) {
+        printf("%d ", fc->ranks[i]);
+        if(MPI_PROC_NULL == fc->ranks[i]) {
             rank = MPI_PROC_NULL;
         }
     }
@@ -0,0 +1,81 @@
+#!/bin/bash
+
+# Sweep of the failure detector settings with sleeptest: for each
+# heartbeat period and timeout, each compute silence and each message
+# size, run sleeptest without failure (a fault reported is a false
+# positive) and with the last rank killed (the latency of rank 0 to
+# detect it). The detector is set with the OMPI_MCA_mpi_ft_detector_*
+# environment variables.
+#
+# Output, one line per setting:
+#   PERIOD TIMEOUT SILENCE INTS  FALSE_POSITIVES/RUNS  DETECTION(s)
+
+# default values for the sweep
+prefix=${ULFM_PREFIX+$ULFM_PREFIX}
+np=4
+time=5m
+runs=3
+iterations=3
+periods="0.5 1 3"
+timeouts="1 3 10"
+silences="1 5 20"
+counts="512 4194304"
+#args="--mca btl_tcp_if_include ib1 --mca btl tcp,self" # for example, use TCPoIB on ib1 iface
+
+while getopts "p:n:a:t:r:i:P:T:s:c:" OPTION; do
+    case $OPTION in
+    p) prefix=$OPTARG ;;
+    n) np=$OPTARG ;;
+    a) args=$OPTARG ;;
+    t) time=$OPTARG ;;
+    r) runs=$OPTARG ;;
+    i) iterations=$OPTARG ;;
+    P) periods=$OPTARG ;;
+    T) timeouts=$OPTARG ;;
+    s) silences=$OPTARG ;;
+    c) counts=$OPTARG ;;
+    *) cat <<'EOF'
+Invalid option provided
+
+-p: prefix (path to root dir of the Open MPI installation)
+-n: np (number of procs)
+-a: args (extra arguments to pass to mpiexec)
+-t: timeout of one run (e.g., 10s, 6m, 2h)
+-r: runs per setting
+-i: iterations of sleeptest per run
+-P: heartbeat periods, in seconds (e.g., "0.5 1 3")
+-T: detector timeouts, in seconds (e.g., "1 3 10")
+-s: compute silences, in seconds (e.g., "1 5 20")
+-c: message sizes, in ints (e.g., "512 4194304")
+EOF
+    exit 1
+    ;;
+    esac
+done
+mpiexec="${prefix+$prefix/bin/}mpiexec $args"
+
+echo "# np=$np runs=$runs iterations=$iterations"
+echo "# PERIOD TIMEOUT SILENCE INTS  FALSE_POSITIVES/RUNS  DETECTION(s)"
+for period in $periods; do
+    for timeout in $timeouts; do
+        # the timeout has to cover at least one period
+        if [ $(echo "$timeout < $period" | bc -l) = 1 ]; then continue; fi
+        export OMPI_MCA_mpi_ft_detector=true
+        export OMPI_MCA_mpi_ft_detector_period=$period
+        export OMPI_MCA_mpi_ft_detector_timeout=$timeout
+        for silence in $silences; do
+            for count in $counts; do
+                fp=0
+                detection=""
+                for run in $(seq $runs); do
+                    timeout $time $mpiexec -np $np --with-ft mpi ./sleeptest $silence $iterations $count \
+                        | grep -q "NOT COMPLIANT" && fp=$((fp + 1))
+                    d=$(timeout $time $mpiexec -np $np --with-ft mpi ./sleeptest $silence 2 $count 1 \
+                        | awk '/DETECTED/{print ($NF == "COMPLIANT")? $7: "-"}')
+                    detection="$detection ${d:--}"
+                done
+                printf "%6s %7s %7s %9s  %d/%d %s\n" $period $timeout $silence $count $fp $runs "$detection"
+            done
+        done
+    done
+done
@@ -12,12 +12,21 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <signal.h>
 #include <mpi.h>
+#include <mpi-ext.h>
 
 /* This test stresses that the failure detector remains accurate under
  * conditions in which MPI progress is sparse. We add sleeps timers to
  * simulate periods in which the application would be busy computing and would
  * not call any MPI procedures for a while.
+ *
+ * Usage: sleeptest [how_long [iterations [count [kill_at]]]]
+ *  count ints are sent on the ring (512 by default, up to 4M). When
+ *  kill_at is given, the last rank dies at the start of that iteration,
+ *  while the others go to MPI_Waitall without computing: rank 0, which
+ *  receives from it, reports the detection latency. sleeptest-sweep.sh
+ *  runs it over ranges of these parameters and detector settings.
  */
 
 static void compute(int how_long);
@@ -32,9 +41,10 @@ int main(int argc, char* argv[]) {
      * iteration, one per process per iteration) */
     int left = MPI_PROC_NULL, right = MPI_PROC_NULL;
     int rank = MPI_PROC_NULL, size = 0;
-    int tag = 42, iterations = 12, how_long = 5;
+    int tag = 42, iterations = 12, how_long = 5, msg = 512, kill_at = -1, rc, flag;
     MPI_Request reqs[2] = { MPI_REQUEST_NULL };
     double post_date, wait_date, complete_date;
+    char errstr[MPI_MAX_ERROR_STRING];
 
     MPI_Init(&argc, &argv);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
@@ -48,20 +58,47 @@ int main(int argc, char* argv[]) {
     if( argc > 2) {
         iterations = atoi(argv[2]);
     }
+    if( argc > 3) {
+        msg = atoi(argv[3]);
+        if( msg > count ) msg = count;
+    }
+    if( argc > 4) {
+        kill_at = atoi(argv[4]);
+    }
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
 
 /**** Done with initialization, main loop now ************************/
     MPI_Barrier(MPI_COMM_WORLD);
-    if(0 == rank) printf("Entering test; computing silently for %d seconds\n", how_long);
+    if(0 == rank) printf("Entering test; computing silently for %d seconds, %d ints per message\n", how_long, msg);
 
     for(int i = 0; i < iterations; i++) {
       MPI_Barrier(MPI_COMM_WORLD);
       post_date = MPI_Wtime();
-      MPI_Irecv(recv_buff, 512, MPI_INT, left, tag, MPI_COMM_WORLD, &reqs[0]);
-      MPI_Isend(send_buff, 512, MPI_INT, right, tag, MPI_COMM_WORLD, &reqs[1]);
-      compute(how_long);
+      if( i == kill_at && rank == size-1 ) {
+          raise(SIGKILL);
+      }
+      MPI_Irecv(recv_buff, msg, MPI_INT, left, tag, MPI_COMM_WORLD, &reqs[0]);
+      MPI_Isend(send_buff, msg, MPI_INT, right, tag, MPI_COMM_WORLD, &reqs[1]);
+      if( i != kill_at ) compute(how_long);
       wait_date = MPI_Wtime();
-      MPI_Waitall(2, reqs, MPI_STATUSES_IGNORE);
+      rc = MPI_Waitall(2, reqs, MPI_STATUSES_IGNORE);
       complete_date = MPI_Wtime();
+      if( i == kill_at ) {
+          /* the survivors leave together, the failure acknowledged or not */
+          flag = 1;
+          MPIX_Comm_agree(MPI_COMM_WORLD, &flag);
+          if(0 == rank) printf("%02d\tIteration %02d of %d\tDETECTED %g (s) after the failure: %s\n",
+                               rank, i, iterations, complete_date - post_date,
+                               (MPI_SUCCESS == rc)? "NOT REPORTED": "COMPLIANT");
+          MPI_Finalize();
+          return 0;
+      }
+      if( MPI_SUCCESS != rc ) {
+          MPI_Error_string(rc, errstr, &flag);
+          printf("%02d\tIteration %02d of %d\tSpurious fault reported after %g (s): %s\nNOT COMPLIANT\n",
+                 rank, i, iterations, complete_date - post_date, errstr);
+          MPI_Abort(MPI_COMM_WORLD, rc);
+      }
       printf("%02d\tIteration %02d of %d\tWorked %g (s)\tMPI_Wait-ed %g (s)\n",
              rank, i, iterations,
              wait_date - post_date,
@@ -0,0 +1,285 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2019-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ *
+ * Stress test for concurrent error delivery to threads:
+ *  each rank runs T threads (-t), each doing a ring exchange and an
+ *  allreduce in a loop on its own duplicate of MPI_COMM_WORLD, while
+ *  waves (-w) of K ranks (-k) are killed every -i seconds. A thread
+ *  that sees an error recovers on its communicator (revoke and shrink),
+ *  while the others may be doing the same on theirs. The latency of the
+ *  operations, and the time to return an error, are kept in
+ *  histograms per thread. A watchdog aborts if a thread is stuck in an
+ *  operation for more than -W seconds.
+ *
+ * PASSED: the test completes, every thread ends on a communicator with
+ *  all the survivors, reports SUCCESS.
+ * FAILED: the watchdog aborts (deadlock), or the test reports FAILURE.
+ */
+
+#include <mpi.h>
+#include <mpi-ext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+#define NB_BUCKETS 24   /* 1us, 2us, 4us... 8s and more */
+
+typedef struct {
+    pthread_t       tid;
+    int             id;
+    MPI_Comm        comm;
+    volatile double heartbeat;  /* when the current operation began, 0 if none */
+    const char*     volatile op;
+    volatile int    done;
+    long            lat[NB_BUCKETS];  /* successful operations */
+    long            err[NB_BUCKETS];  /* operations that returned an error */
+    long            recoveries;
+    double          maxrecovery;
+    int             size;             /* of comm at the end */
+} thread_t;
+
+static int nthreads = 4, waves = 3, kpw = 1, watchdog = 30, survivors;
+static double interval = 1.0, t0;
+
+static void record(long* h, double t)
+{
+    int b = 0;
+    double us = t * 1e6;
+
+    while( us >= 2.0 && b < NB_BUCKETS - 1 ) {
+        us /= 2.0;
+        b++;
+    }
+    h[b]++;
+}
+
+static int timed(thread_t* th, int rc, double start)
+{
+    double t = MPI_Wtime() - start;
+
+    th->heartbeat = 0.0;
+    record(MPI_SUCCESS == rc? th->lat: th->err, t);
+    return rc;
+}
+
+static void* worker(void* arg)
+{
+    thread_t* th = (thread_t*)arg;
+    MPI_Comm ncomm;
+    int rank, size, sb, rb, sum, flag, ok, rc;
+    double end = (waves + 1) * interval, start;
+
+    do {
+        MPI_Comm_rank(th->comm, &rank);
+        MPI_Comm_size(th->comm, &size);
+        ok = 1;
+
+        th->op = "Sendrecv";
+        th->heartbeat = start = MPI_Wtime();
+        sb = rank;
+        rc = MPI_Sendrecv(&sb, 1, MPI_INT, (rank + 1) % size, th->id,
+                          &rb, 1, MPI_INT, (rank + size - 1) % size, th->id,
+                          th->comm, MPI_STATUS_IGNORE);
+        if( MPI_SUCCESS != timed(th, rc, start) ) ok = 0;
+
+        th->op = "Allreduce";
+        th->heartbeat = start = MPI_Wtime();
+        sb = 1;
+        rc = MPI_Allreduce(&sb, &sum, 1, MPI_INT, MPI_SUM, th->comm);
+        if( MPI_SUCCESS != timed(th, rc, start) ) ok = 0;
+
+        /* the decisions (recover, stop) have to be the same everywhere:
+         * stop once all are past the last wave, and all the failures
+         * have been recovered from (the communicator has the survivors) */
+        th->op = "Agree";
+        th->heartbeat = start = MPI_Wtime();
+        flag = ok | ((MPI_Wtime() - t0 >= end && size == survivors) << 1);
+        rc = MPIX_Comm_agree(th->comm, &flag);
+        th->heartbeat = 0.0;
+        if( MPI_SUCCESS != rc ) MPIX_Comm_failure_ack(th->comm);
+
+        if( !(flag & 1) ) {
+            th->op = "Shrink";
+            th->heartbeat = start = MPI_Wtime();
+            MPIX_Comm_revoke(th->comm);
+            MPIX_Comm_shrink(th->comm, &ncomm);
+            MPI_Comm_free(&th->comm);
+            th->comm = ncomm;
+            MPI_Comm_set_errhandler(th->comm, MPI_ERRORS_RETURN);
+            start = MPI_Wtime() - start;
+            th->heartbeat = 0.0;
+            th->recoveries++;
+            if( start > th->maxrecovery ) th->maxrecovery = start;
+            flag &= ~2; /* at least one more round on the new communicator */
+        }
+    } while( !(flag & 2) );
+
+    MPI_Comm_size(th->comm, &th->size);
+    th->done = 1;
+    return NULL;
+}
+
+static void* watch(void* arg)
+{
+    thread_t* threads = (thread_t*)arg;
+    int i, rank, alive;
+    double hb;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    do {
+        sleep(1);
+        alive = 0;
+        for(i = 0; i < nthreads; i++) {
+            if( threads[i].done ) continue;
+            alive++;
+            hb = threads[i].heartbeat;
+            if( hb > 0.0 && MPI_Wtime() - hb > watchdog ) {
+                printf("Rank %02d thread %d: WATCHDOG, stuck in %s for %.1f s\n\n\nTEST FAILED\n\n",
+                       rank, i, threads[i].op, MPI_Wtime() - hb);
+                fflush(stdout);
+                MPI_Abort(MPI_COMM_WORLD, -1);
+            }
+        }
+    } while( alive );
+    return NULL;
+}
+
+static void print_histogram(const char* name, int t, long* h)
+{
+    int b;
+
+    printf("THREAD %d %-8s", t, name);
+    for(b = 0; b < NB_BUCKETS; b++)
+        if( h[b] ) printf(" [%ldus]=%ld", 1L << b, h[b]);
+    printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+    int provided, rank, np, c, i, killed, victim = -1, result;
+    thread_t* threads;
+    pthread_t wtid;
+    MPI_Comm scomm;
+    long *h, *hsum;
+    double v[2], vmax[2];
+
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    while(1) {
+        static struct option long_options[] = {
+            { "threads",      1, 0, 't' },
+            { "waves",        1, 0, 'w' },
+            { "kills",        1, 0, 'k' },
+            { "interval",     1, 0, 'i' },
+            { "watchdog",     1, 0, 'W' },
+            { NULL,           0, 0, 0   }
+        };
+
+        c = getopt_long(argc, argv, "t:w:k:i:W:", long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch(c) {
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 'w':
+            waves = atoi(optarg);
+            break;
+        case 'k':
+            kpw = atoi(optarg);
+            break;
+        case 'i':
+            interval = atof(optarg);
+            break;
+        case 'W':
+            watchdog = atoi(optarg);
+            break;
+        }
+    }
+
+    if( MPI_THREAD_MULTIPLE != provided ) {
+        printf("This test requires MPI_THREAD_MULTIPLE\n");
+        MPI_Abort(MPI_COMM_WORLD, provided);
+    }
+    /* the highest ranks die, waves*kpw of them, rank 0 survives */
+    if( waves * kpw >= np ) waves = (np - 1) / kpw;
+    killed = waves * kpw;
+    survivors = np - killed;
+    if( rank >= np - killed ) victim = (np - 1 - rank) / kpw;
+
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+    threads = (thread_t*)calloc(nthreads, sizeof(thread_t));
+    for(i = 0; i < nthreads; i++) {
+        threads[i].id = i;
+        MPI_Comm_dup(MPI_COMM_WORLD, &threads[i].comm);
+        MPI_Comm_set_errhandler(threads[i].comm, MPI_ERRORS_RETURN);
+    }
+    if( 0 == rank )
+        printf("Running %d threads per rank, %d waves of %d failures every %g s\n",
+               nthreads, waves, kpw, interval);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    t0 = MPI_Wtime();
+    for(i = 0; i < nthreads; i++)
+        pthread_create(&threads[i].tid, NULL, worker, &threads[i]);
+    pthread_create(&wtid, NULL, watch, threads);
+
+    if( victim >= 0 ) {
+        while( MPI_Wtime() - t0 < (victim + 1) * interval ) usleep(1000);
+        printf("Rank %02d SIGKILL in wave %d\n", rank, victim);
+        raise(SIGKILL); do { pause(); } while(1);
+    }
+
+    for(i = 0; i < nthreads; i++)
+        pthread_join(threads[i].tid, NULL);
+    pthread_join(wtid, NULL);
+
+    /* report on the survivors */
+    MPIX_Comm_shrink(MPI_COMM_WORLD, &scomm);
+    MPI_Comm_rank(scomm, &rank);
+    h = (long*)calloc(2 * NB_BUCKETS, sizeof(long));
+    hsum = (long*)calloc(2 * NB_BUCKETS, sizeof(long));
+    result = 1;
+    for(i = 0; i < nthreads; i++) {
+        memcpy(h, threads[i].lat, sizeof(threads[i].lat));
+        memcpy(h + NB_BUCKETS, threads[i].err, sizeof(threads[i].err));
+        MPI_Reduce(h, hsum, 2 * NB_BUCKETS, MPI_LONG, MPI_SUM, 0, scomm);
+        v[0] = threads[i].maxrecovery;
+        v[1] = threads[i].recoveries;
+        MPI_Reduce(v, vmax, 2, MPI_DOUBLE, MPI_MAX, 0, scomm);
+        if( threads[i].size != np - killed ) {
+            printf("Rank %02d thread %d: ended on a communicator of %d processes, expected %d\n",
+                   rank, i, threads[i].size, np - killed);
+            result = 0;
+        }
+        if( 0 == rank ) {
+            print_histogram("OK", i, hsum);
+            print_histogram("ERROR", i, hsum + NB_BUCKETS);
+            printf("THREAD %d up to %g recoveries, the longest %g s\n", i, vmax[1], vmax[0]);
+        }
+        MPI_Comm_free(&threads[i].comm);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &result, 1, MPI_INT, MPI_LAND, scomm);
+    if( 0 == rank )
+        printf("\n\nTEST COMPLETED: %d threads on %d of %d procs: %s\n\n",
+               nthreads, np - killed, np, result? "SUCCESS": "FAILURE");
+
+    MPI_Comm_free(&scomm);
+    free(h); free(hsum); free(threads);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
@@ -18,6 +18,7 @@
 #include <setjmp.h>
 #include <mpi.h>
 #include <mpi-ext.h>
+#include "ftconsensus.h"
 
 static int MPIX_Comm_replace(MPI_Comm comm, MPI_Comm *newcomm);
 
@@ -44,6 +45,7 @@ static double* buddy_ckpt;
 static const int ckpt_tag = 42;
 #define lbuddy(r) ((r+np-1)%np)
 #define rbuddy(r) ((r+np+1)%np)
+#define restarted(set, r) (((set)[(r)/32] >> ((r)%32)) & 1u)
 
 /* Simplistic buddy checkpointing */
 static int app_buddy_ckpt(MPI_Comm comm) {
@@ -68,35 +70,44 @@ static int app_buddy_ckpt(MPI_Comm comm) {
 /* mockup checkpoint restart: we reset iteration, and we prevent further
  * error injection */
 static int app_reload_ckpt(MPI_Comm comm) {
+    unsigned* restarting;
+    int nwords, lost, buddy_lost;
+
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &np);
 
-    /* send my ckpt_iteration to my buddy to decide if we need to exchange a
-     * checkpoint
-     *   If ckpt_iteration is -1, I am restarting.
-     *   It iteration is -1, then my buddy is restarting.
-     *   Note: if an error occurs now, it will be absorbed by the error handler
-     *   and the restart will be repeated.
+    /* decide which ranks restart (their ckpt_iteration is -1), and the
+     * iteration of the checkpoint we go back to. These are consensus:
+     * all the processes decide alike, even if some fail now.
+     *   Note: if an error occurs in the exchange of the checkpoints, it
+     *   will be absorbed by the error handler and the restart will be
+     *   repeated.
      */
-    MPI_Sendrecv(&ckpt_iteration, 1, MPI_INT, rbuddy(rank), ckpt_tag,
-                 &iteration, 1, MPI_INT, lbuddy(rank), ckpt_tag,
-                 comm, MPI_STATUS_IGNORE);
-
-    if( -1 == iteration && -1 == ckpt_iteration ) {
+    nwords = (np + 31) / 32;
+    restarting = (unsigned*)calloc(nwords, sizeof(unsigned));
+    if( -1 == ckpt_iteration ) restarting[rank/32] |= 1u << (rank%32);
+    ftc_agree_union(comm, restarting, nwords);
+    iteration = (-1 == ckpt_iteration)? INT_MAX: ckpt_iteration;
+    ftc_agree_min(comm, &iteration);
+    lost = restarted(restarting, rank);
+    buddy_lost = restarted(restarting, lbuddy(rank));
+    free(restarting);
+
+    if( lost && buddy_lost ) {
         fprintf(stderr, "Rank %04d: Buddy checkpointing cannot restart from these failures because my buddy %04d wants the checkpoint I have lost...\n", rank, lbuddy(rank));
         MPI_Abort(comm, -1);
     }
 
-    if( -1 == iteration ) {
+    if( buddy_lost ) {
         if(verbose) fprintf(stderr, "Rank %04d: sending checkpoint to %04d at iteration %d\n", rank, lbuddy(rank), ckpt_iteration);
         /* My buddy was dead, send the checkpoint */
         MPI_Send(buddy_ckpt, count, MPI_DOUBLE, lbuddy(rank), ckpt_tag, comm);
     }
-    if( -1 == ckpt_iteration ) {
+    if( lost ) {
         /* I replace a dead, get the ckeckpoint */
         if(verbose) fprintf(stderr, "Rank %04d: restarting from %04d at iteration %d\n", rank, rbuddy(rank), iteration);
         MPI_Recv(mydata_array, count, MPI_DOUBLE, rbuddy(rank), ckpt_tag, comm, MPI_STATUS_IGNORE);
-        /* iteration has already been set by the sendrecv above */
+        /* iteration has already been decided above */
     }
     else {
         /* I am a survivor,
@@ -104,8 +115,6 @@ static int app_reload_ckpt(MPI_Comm comm) {
         MPI_Sendrecv(my_ckpt, count, MPI_DOUBLE, 0, ckpt_tag,
                      mydata_array, count, MPI_DOUBLE, 0, ckpt_tag,
                      MPI_COMM_SELF, MPI_STATUS_IGNORE);
-        /* Reset iteration */
-        iteration = ckpt_iteration;
     }
     return 0;
 }
@@ -14,55 +14,15 @@
 #include <mpi-ext.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
-#include <setjmp.h>
-#include <assert.h>
+#include <unistd.h>
 #include <signal.h>
+#include "libtran.h"
 
-#define STACK_SIZE 10
-
-static jmp_buf* stack_jmp_buf;
-static int __stack_in_agree = 0;
-static int __stack_pos = 0;
-
-#define TRY_BLOCK(COMM, EXCEPTION) \
-  do { \
-    int __flag = 0xffffffff; \
-    __stack_pos++; assert(__stack_pos < STACK_SIZE);\
-    EXCEPTION = setjmp(stack_jmp_buf[__stack_pos]); \
-    __flag &= ~EXCEPTION; \
-    if( 0 == EXCEPTION ) {
-
-#define CATCH_BLOCK(COMM)  \
-    __stack_pos--; \
-    __stack_in_agree = 1; \
-    MPIX_Comm_agree(COMM, &__flag); \
-    __stack_in_agree = 0; \
-  } \
-  if( 0xffffffff != __flag ) {
-
-#define END_BLOCK() \
-  } } while (0);
-
-#define RAISE(COMM, EXCEPTION) \
-  MPIX_Comm_revoke(COMM); \
-  assert(0 != (EXCEPTION)); \
-  if(!__stack_in_agree ) \
-    longjmp( stack_jmp_buf[__stack_pos], (EXCEPTION) ); /* escape from hell */
-
-int libtran_init(void)
+/* busy for usec microseconds */
+static void work(double usec)
 {
-    stack_jmp_buf = (jmp_buf*)malloc( sizeof(jmp_buf) * STACK_SIZE );
-    return 0;
-}
-
-int libtran_fini(void)
-{
-    if( NULL != stack_jmp_buf ) {
-        free(stack_jmp_buf);
-        stack_jmp_buf = NULL;
-    }
-    return 0;
+    double start = MPI_Wtime();
+    while( (MPI_Wtime() - start) * 1e6 < usec );
 }
 
 void error_handler( MPI_Comm* pcomm, int* prc, ... )
@@ -72,7 +32,7 @@ void error_handler( MPI_Comm* pcomm, int* prc, ... )
 
     MPI_Comm_rank(*pcomm, &rank);
     printf( "Error handler called on rank %d for communicator %p (try catch step %d)\n",
-            rank, *pcomm, __stack_pos );
+            rank, *pcomm, __libtran_depth );
     MPI_Error_string( *prc, errstr, &len );
     printf( "\terror was %d %s\n", *prc, errstr );
     RAISE(*pcomm, 1);
@@ -80,9 +40,26 @@ void error_handler( MPI_Comm* pcomm, int* prc, ... )
 
 int main( int argc, char* argv[] )
 {
-    int exception, rank, size, rc;
+    int exception, rank, size, rc, c;
+    int group = 1, window = 0, niter = 1000;
+    double usec = 10.0, start;
+    volatile int i, raised = 0;
     MPI_Errhandler err_handler;
-    MPI_Comm newcomm;
+    MPI_Comm newcomm, scomm;
+
+    /* -g: blocks per agreement, -w: agreements in flight, -n: number of
+     * fine-grained transactions of -u microseconds */
+    while( -1 != (c = getopt(argc, argv, "g:w:n:u:")) ) {
+        switch( c ) {
+        case 'g': group = atoi(optarg); break;
+        case 'w': window = atoi(optarg); break;
+        case 'n': niter = atoi(optarg); break;
+        case 'u': usec = atof(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-g group] [-w window] [-n transactions] [-u usec]\n", argv[0]);
+            return 1;
+        }
+    }
 
     MPI_Init(NULL, NULL);
     libtran_init();
@@ -115,6 +92,43 @@ int main( int argc, char* argv[] )
     } END_BLOCK()
 
     MPI_Comm_free(&newcomm);
+
+    /* Fine-grained transactions, among the survivors: with group
+     * commit, the agreement is paid every 'group' blocks, and with a
+     * window, it is overlapped with the next blocks. Rank 0 raises an
+     * exception once, half-way: the blocks since the oldest uncommitted
+     * one are undone, and done again. */
+    MPIX_Comm_shrink(MPI_COMM_WORLD, &scomm);
+    MPI_Comm_set_errhandler(scomm, err_handler);
+    MPI_Comm_rank(scomm, &rank);
+    MPI_Comm_size(scomm, &size);
+    libtran_set_commit(group, window);
+    start = MPI_Wtime();
+    for( i = 0; i < niter; i++ ) {
+        TRY_BLOCK(scomm, exception) {
+
+            work(usec);
+            if( 0 == rank && niter/2 == i && !raised ) {
+                raised = 1;
+                RAISE(scomm, 2);
+            }
+
+        } CATCH_BLOCK(scomm) {
+            if( 0 == rank )
+                printf("Rank %d/%d catch transaction %d (exception %d), %d undone\n",
+                       rank, size, i - libtran_undone(), exception, libtran_undone());
+            i -= libtran_undone() + 1; /* do them again */
+            MPIX_Comm_shrink(scomm, &newcomm);
+            MPI_Comm_free(&scomm);
+            scomm = newcomm;
+        } END_BLOCK()
+    }
+    libtran_flush(); /* may go back in the loop */
+    if( 0 == rank )
+        printf("%d transactions of %g us, group %d, window %d: %g us per transaction\n",
+               niter, usec, group, window, (MPI_Wtime() - start) * 1e6 / niter);
+
+    MPI_Comm_free(&scomm);
     libtran_fini();
     MPI_Finalize();
 }
@@ -0,0 +1,79 @@
+#!/bin/bash
+
+# Throughput and recovery of the bag of tasks, run-through (blank) vs
+# shrink. For each recovery mode, a run without failure gives the
+# nominal throughput, then a run with the kill schedule gives:
+#  - the time lost per failure: extra time to solution over the nominal
+#    run, divided by the number of failures;
+#  - the time the master took to get back to work, and the slices done
+#    again;
+#  - the master CPU time and busy fraction (not waiting for results).
+# The slices done per interval of the failure runs are saved in
+# rate_<mode>.dat (time, slices/s), for plotting.
+
+# default values for test setup
+prefix=${ULFM_PREFIX+$ULFM_PREFIX}
+np=8
+slices=100000
+taskusec=100
+dist=const
+kills="2@1,4@2,6@3"
+modes="blank shrink"
+interval=0.25
+batch=4
+
+while getopts "p:n:s:t:d:K:m:i:b:a:" OPTION; do
+    case $OPTION in
+    p) prefix=$OPTARG ;;
+    n) np=$OPTARG ;;
+    s) slices=$OPTARG ;;
+    t) taskusec=$OPTARG ;;
+    d) dist=$OPTARG ;;
+    K) kills=$OPTARG ;;
+    m) modes=$OPTARG ;;
+    i) interval=$OPTARG ;;
+    b) batch=$OPTARG ;;
+    a) args=$OPTARG ;;
+    *) cat <<'EOF'
+Invalid option provided
+
+-p: prefix (path to root dir of the Open MPI installation)
+-n: number of procs
+-s: number of slices
+-t: mean duration of a slice in microseconds
+-d: distribution of the slice durations (const, exp, pareto)
+-K: kill schedule, world rank@seconds (e.g., "2@1,4@2")
+-m: list of recovery modes (blank, shrink)
+-i: interval of the throughput samples, in seconds
+-b: slices per batch
+-a: args (extra arguments to pass to mpiexec)
+EOF
+    exit 1
+    ;;
+    esac
+done
+mpiexec="${prefix:+$prefix/bin/}mpiexec $args"
+nkills=$(echo $kills | tr ',' '\n' | grep -c @)
+
+function run {
+    local mode=$1
+    shift
+    $mpiexec -np $np ./fsolvegen_$mode -q -b $batch -k 2 -t $taskusec -d $dist "$@" $slices
+}
+
+echo "# np $np, $slices slices of $taskusec us ($dist), kills $kills"
+printf "%-7s %10s %10s %10s %10s %10s %8s %8s %8s\n" "#mode" "nominal/s" "failed/s" \
+    "lost/fail" "recover" "redone" "cpu(s)" "cpu%" "busy%"
+for mode in $modes; do
+    base=$(run $mode -K none | awk '$2 == "THROUGHPUT" { print $6 }')
+    run $mode -K $kills -i $interval > out_$mode.txt
+    awk '$2 == "RATE" { print $3, $4 }' out_$mode.txt > rate_$mode.dat
+    awk -v mode=$mode -v base=$base -v slices=$slices -v nk=$nkills '
+        $2 == "THROUGHPUT" { t = $6 }
+        $2 == "STATS" { recover = $5; redone = $9; cpu = $14; cpup = $16; busy = $18 }
+        END {
+            gsub(/[(),%]/, "", cpup); gsub(/%/, "", busy);
+            printf("%-7s %10.1f %10.1f %10.3g %10.3g %10s %8s %8s %8s\n", mode,
+                   slices / base, slices / t, nk? (t - base) / nk: 0, recover, redone, cpu, cpup, busy)
+        }' out_$mode.txt
+done
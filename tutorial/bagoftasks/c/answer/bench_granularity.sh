@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# Throughput of the bag of tasks (slices/s) against the duration of a
+# slice, one column per protocol mode:
+#   single:    one slice per message, the worker waits for the round trip
+#   batch:     fixed batches of -b slices, -k batches in flight per worker
+#   adaptive:  batches sized from the measured slice and round trip times
+# The runs have no failure (-K none), to measure the protocol alone.
+
+# default values for test setup
+prefix=${ULFM_PREFIX+$ULFM_PREFIX}
+np=8
+slices=100000
+batch=256
+prefetch=2
+durations="0 1 2 5 10 20 50 100"
+prog=./fsolvegen_blank
+
+while getopts "p:n:s:b:k:d:x:a:" OPTION; do
+    case $OPTION in
+    p) prefix=$OPTARG ;;
+    n) np=$OPTARG ;;
+    s) slices=$OPTARG ;;
+    b) batch=$OPTARG ;;
+    k) prefetch=$OPTARG ;;
+    d) durations=$OPTARG ;;
+    x) prog=$OPTARG ;;
+    a) args=$OPTARG ;;
+    *) cat <<'EOF'
+Invalid option provided
+
+-p: prefix (path to root dir of the Open MPI installation)
+-n: np (number of procs, including the master)
+-s: number of slices
+-b: batch size (maximum batch size in adaptive mode)
+-k: number of batches in flight per worker
+-d: list of slice durations in microseconds (e.g., "1 10 100")
+-x: program to run (default ./fsolvegen_blank)
+-a: args (extra arguments to pass to mpiexec)
+EOF
+    exit 1
+    ;;
+    esac
+done
+mpiexec="${prefix:+$prefix/bin/}mpiexec $args"
+
+function throughput {
+    $mpiexec -np $np $prog -q -K none "$@" $slices | awk '$2 == "THROUGHPUT" { print $8 }'
+}
+
+echo "# np $np, $slices slices, batch $batch, prefetch $prefetch"
+printf "%-10s %14s %14s %14s\n" "#slice(us)" "single" "batch" "adaptive"
+for t in $durations; do
+    single=$(throughput -t $t)
+    fixed=$(throughput -t $t -b $batch -k $prefetch)
+    adapt=$(throughput -t $t -b $batch -k $prefetch -a)
+    printf "%-10s %14s %14s %14s\n" $t "$single" "$fixed" "$adapt"
+done
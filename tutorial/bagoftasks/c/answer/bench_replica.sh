@@ -0,0 +1,75 @@
+#!/bin/bash
+
+# Standby masters (shrink mode).
+#  1. overhead: throughput of the master with 0..-r standbys, without
+#     failure, for a range of slice durations.
+#  2. failover: the master dies halfway through; report the takeover
+#     time, the slices the new master got from its replica, and the
+#     throughput after the takeover.
+# No worker fails (-K none), to measure the master alone.
+
+# default values for test setup
+prefix=${ULFM_PREFIX+$ULFM_PREFIX}
+np=8
+slices=100000
+tasks="0 10 100"
+replicas=2
+batch=8
+prog=./fsolvegen_shrink
+
+while getopts "p:n:s:t:r:b:x:a:" OPTION; do
+    case $OPTION in
+    p) prefix=$OPTARG ;;
+    n) np=$OPTARG ;;
+    s) slices=$OPTARG ;;
+    t) tasks=$OPTARG ;;
+    r) replicas=$OPTARG ;;
+    b) batch=$OPTARG ;;
+    x) prog=$OPTARG ;;
+    a) args=$OPTARG ;;
+    *) cat <<'EOF'
+Invalid option provided
+
+-p: prefix (path to root dir of the Open MPI installation)
+-n: number of procs
+-s: number of slices
+-t: list of slice durations in microseconds (e.g., "0 10 100")
+-r: maximum number of standby masters
+-b: slices per batch
+-x: program to run (default ./fsolvegen_shrink)
+-a: args (extra arguments to pass to mpiexec)
+EOF
+    exit 1
+    ;;
+    esac
+done
+mpiexec="${prefix:+$prefix/bin/}mpiexec $args"
+
+function run {
+    $mpiexec -np $np $prog -q -K none -b $batch -k 2 "$@" $slices
+}
+
+echo "# np $np, $slices slices, batch $batch: slices/s with r standbys (overhead vs r=0)"
+printf "%-8s" "#us"
+for r in $(seq 0 $replicas); do printf " %20s" "r=$r"; done
+echo
+for t in $tasks; do
+    printf "%-8s" $t
+    base=
+    for r in $(seq 0 $replicas); do
+        rate=$(run -t $t -r $r | awk '$2 == "THROUGHPUT" { print $8 }')
+        [ -z "$base" ] && base=$rate
+        printf " %20s" "$rate ($(echo "$base $rate" | awk '{ printf("%+.1f%%", ($1 - $2) / $1 * 100) }'))"
+    done
+    echo
+done
+
+echo
+echo "# master failure halfway through, slice of the first duration"
+printf "%-9s %12s %12s %14s\n" "#standbys" "takeover(s)" "replicated" "slices/s after"
+for r in $(seq 1 $replicas); do
+    run -t ${tasks%% *} -r $r -x | awk -v r=$r '
+        $2 == "took" { took = $5; repl = $7 }
+        $2 == "THROUGHPUT" { rate = $8 }
+        END { printf("%-9s %12s %12s %14s\n", r, took, repl, rate) }'
+done
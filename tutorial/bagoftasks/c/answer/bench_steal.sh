@@ -0,0 +1,75 @@
+#!/bin/bash
+
+# Work stealing against the centralized master.
+#  1. strong scaling: throughput (slices/s) and parallel efficiency of both
+#     modes for a fixed bag, as the number of processes grows. The
+#     efficiency is the throughput per working process (np-1 for the
+#     master, np for stealing), relative to the smallest run.
+#  2. failures: throughput and slices done again by work stealing when
+#     0..-f processes die during the run.
+# No worker fails in the runs with a master (-K none).
+
+# default values for test setup
+prefix=${ULFM_PREFIX+$ULFM_PREFIX}
+nps="4 8 16 32"
+slices=100000
+taskusec=10
+failures=3
+prog=./fsolvegen_blank
+
+while getopts "p:n:s:t:f:x:a:" OPTION; do
+    case $OPTION in
+    p) prefix=$OPTARG ;;
+    n) nps=$OPTARG ;;
+    s) slices=$OPTARG ;;
+    t) taskusec=$OPTARG ;;
+    f) failures=$OPTARG ;;
+    x) prog=$OPTARG ;;
+    a) args=$OPTARG ;;
+    *) cat <<'EOF'
+Invalid option provided
+
+-p: prefix (path to root dir of the Open MPI installation)
+-n: list of number of procs (e.g., "4 8 16")
+-s: number of slices
+-t: duration of a slice in microseconds
+-f: maximum number of failures (for the largest np)
+-x: program to run (default ./fsolvegen_blank)
+-a: args (extra arguments to pass to mpiexec)
+EOF
+    exit 1
+    ;;
+    esac
+done
+mpiexec="${prefix:+$prefix/bin/}mpiexec $args"
+
+function throughput {
+    local np=$1
+    shift
+    $mpiexec -np $np $prog -q -K none -t $taskusec "$@" $slices | awk '$2 == "THROUGHPUT" { print $8, $0 }'
+}
+
+echo "# $slices slices of $taskusec us"
+printf "%-6s %14s %8s %14s %8s\n" "#np" "master" "eff" "stealing" "eff"
+for np in $nps; do
+    master=$(throughput $np | cut -d' ' -f1)
+    steal=$(throughput $np -w | cut -d' ' -f1)
+    [ -z "$master0" ] && master0=$(echo "$master $np" | awk '{ print $1 / ($2-1) }')
+    [ -z "$steal0" ] && steal0=$(echo "$steal $np" | awk '{ print $1 / $2 }')
+    printf "%-6s %14s %8.3f %14s %8.3f\n" $np "$master" \
+        $(echo "$master $np $master0" | awk '{ print $1 / ($2-1) / $3 }') "$steal" \
+        $(echo "$steal $np $steal0" | awk '{ print $1 / $2 / $3 }')
+done
+
+echo
+echo "# work stealing with failures, np $np"
+printf "%-9s %14s %14s %10s\n" "#failures" "slices/s" "redone" "steals"
+for f in $(seq 0 $failures); do
+    throughput $np -w -f $f | awk -v f=$f '{
+        gsub(/[(),]/, "");
+        for(i = 1; i < NF; i++) {
+            if($(i+1) == "steals") steals = $i;
+            if($(i+1) == "slices" && $(i+2) == "redone") redone = $i;
+        }
+        printf("%-9s %14s %14s %10s\n", f, $1, redone, steals) }'
+done
@@ -18,6 +18,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <mpi.h>
 #include <mpi-ext.h>
 #include "fsolvergen.h"
@@ -33,10 +34,10 @@ void error_handler(MPI_Comm *pcommunicator, int *error_code, ...) {
    char error_string[MPI_MAX_ERROR_STRING];
    // Failed group handle and members array
    MPI_Group f_group;
-   int f_group_rank[MAX_SIZE];
+   int *f_group_rank;
    // Original group handle and members array
    MPI_Group w_group;
-   int w_group_rank[MAX_SIZE];
+   int *w_group_rank;
 
    // Who I was on the original communicator (for debugging purposes)
    MPI_Comm_rank(communicator, &myrank);
@@ -55,6 +56,8 @@ void error_handler(MPI_Comm *pcommunicator, int *error_code, ...) {
          MPIX_Comm_failure_get_acked(communicator, &f_group);
          //     Get no. of failed procs
          MPI_Group_size(f_group, &num_fails);
+         f_group_rank = (int*)malloc(num_fails * sizeof(int));
+         w_group_rank = (int*)malloc(num_fails * sizeof(int));
          //     Get ranks of failed procs in the original communicator
          for(i = 0; i < num_fails; i++) f_group_rank[i] = i;
          MPI_Group_translate_ranks(f_group, num_fails, f_group_rank,
@@ -64,6 +67,7 @@ void error_handler(MPI_Comm *pcommunicator, int *error_code, ...) {
             printf("R%02d: Peer R%02d dead\n", myrank, w_group_rank[i]);
             mark_dead(w_group_rank[i]);
          }
+         free(f_group_rank); free(w_group_rank);
          return;
       }
    }
@@ -11,10 +11,13 @@
 
 /*     If a processor failed, acknowledge the error and rebuilt the
  *     communication. If master proc revoke the communicator and
- *     build a new one.
+ *     build a new one. If the master failed and there are standby
+ *     masters, the worker that noticed revokes the communicator, and
+ *     the survivors elect the new master after the shrink.
  */     
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <mpi.h>
 #include <mpi-ext.h>
 #include "fsolvergen.h"
@@ -24,10 +27,12 @@ void error_handler(MPI_Comm *pcomm, int *error_code, ...) {
    int rc, i, myrank, oldrank, num_fails, error_class;
    char error_string[MPI_MAX_ERROR_STRING];
    MPI_Group f_group, w_group;
-   int f_group_rank[MAX_SIZE], w_group_rank[MAX_SIZE];
+   int *f_group_rank, *w_group_rank;
    MPI_Comm communicator = *pcomm, new_comm;
-   int mapsto[MAX_SIZE];
+   int *mapsto = NULL;
 
+   // If the master is dead, its takeover starts now
+   replica_suspect();
 
    // Who I was on the original communicator (for debugging purposes)
    MPI_Comm_rank(communicator, &myrank);
@@ -48,6 +53,8 @@ void error_handler(MPI_Comm *pcomm, int *error_code, ...) {
          MPIX_Comm_failure_get_acked(communicator, &f_group);
          //     Get no. of failed procs
          MPI_Group_size(f_group, &num_fails);
+         f_group_rank = (int*)malloc(num_fails * sizeof(int));
+         w_group_rank = (int*)malloc(num_fails * sizeof(int));
          //     Get ranks of failed procs in the original comm
          for(i = 0; i < num_fails; i++) f_group_rank[i] = i;
          MPI_Group_translate_ranks(f_group, num_fails, f_group_rank,
@@ -55,44 +62,49 @@ void error_handler(MPI_Comm *pcomm, int *error_code, ...) {
          //     And mark them dead
          for(i = 0; i < num_fails; i++) 
             mark_dead(w_group_rank[i]);
-         //     Stop the workers
-         MPIX_Comm_revoke(communicator);
+         free(f_group_rank); free(w_group_rank);
+      }
+      else if(0 < nreplicas) {
+         //     Workers only talk to the master: a standby will take over
+         printf("R%02d: Looks like the master has failed; electing a standby\n", myrank);
       }
       else {
          printf("R%02d: Looks like the master has failed; calling abort...", myrank);
          MPI_Abort(MPI_COMM_SELF, 2);
       }
-      //       Create a new communicator
-      MPIX_Comm_shrink(communicator, &new_comm);
-      communicator = new_comm;
-      oldrank = myrank;
-      MPI_Comm_size(communicator, &maxworkers);
-      maxworkers = maxworkers - 1; // do not double count the master
-      //     Tell the storage, to map from old to new communicator:
-      //     Gather: old process ranks at location new process
-      MPI_Gather(&oldrank, 1, MPI_INT,
-                 mapsto,  1, MPI_INT,
-                 0, communicator);
-      for(i = 1; i <= maxworkers; i++) {
-         printf("MASTER: worker R%02d is now R%02d\n", mapsto[i], i);
-         state[i]       = state[mapsto[i]];
-         currentwork[i] = currentwork[mapsto[i]];
-      }
-      break;
-   
+      //     Stop the others
+      MPIX_Comm_revoke(communicator);
+      /* fallthrough */
+
    case MPI_ERR_REVOKED:
-      //     This is a worker
-      //     Create a new communicator:
+      //     Create a new communicator
       MPIX_Comm_shrink(communicator, &new_comm);
       communicator = new_comm;
       oldrank = myrank;
-      MPI_Comm_size (communicator, &maxworkers);
-      //     Tell the storage, to map from old to new communicator:
+      MPI_Comm_size(communicator, &maxworkers);
+      //     Tell everybody, to map from old to new communicator:
       //     Gather: old process ranks at location new process
-      MPI_Gather(&oldrank, 1, MPI_INT, 
-                 mapsto, 1, MPI_INT,
-                 0, communicator);
+      mapsto = (int*)malloc(maxworkers * sizeof(int));
+      MPI_Allgather(&oldrank, 1, MPI_INT,
+                    mapsto,  1, MPI_INT, communicator);
       maxworkers = maxworkers - 1; // do not double count the master
+      if(0 == mapsto[0]) {
+         //     The master is still here
+         if(0 == myrank) {
+            for(i = 1; i <= maxworkers; i++) {
+               printf("MASTER: worker R%02d is now R%02d\n", mapsto[i], i);
+               remap_worker(i, mapsto[i]);
+            }
+         }
+      }
+      else if(!replica_failover(&communicator)) {
+         printf("R%02d: The master has failed and there is no standby; calling abort...", myrank);
+         MPI_Abort(MPI_COMM_SELF, 2);
+      }
+      free(mapsto);
+      comm = communicator;
+      replica_update();
+      regrow_update();
       break;
    
    default:
@@ -15,13 +15,18 @@
 //  Message Tags
 #define WORK_TAG			100
 #define RES_TAG				200
+#define CHUNK_TAG			300
+#define REPLY_TAG			400
 
 //  contents of message the indicates no more work (i.e. FINISHed)
 #define FINISH				(-999)
 
-//  sizes 
-#define MAX_SIZE			128
-#define SLICES				(MAX_SIZE * 5)
+//  contents of message that tells the workers to merge with new ones,
+//  followed by the rank of the worker that spawned them
+#define GROW				(-998)
+
+//  default number of slices per process
+#define SLICES_PER_PROC		5
 
 //  worker state 
 #define AVAILABLE			0
@@ -47,15 +52,13 @@
 #define WINPROGRESS			1
 #define WDONE				2
 
-//  work structure
-extern int wworkid[SLICES];
-extern int wrank[SLICES];
-extern int wworkstate[SLICES];
+//  work structure (nslices entries)
+extern int *wrank;
+extern int *wworkstate;
 
-//  proc structure
-extern int rank[MAX_SIZE];
-extern int currentwork[MAX_SIZE];
-extern int state[MAX_SIZE];
+//  proc structure (maxworkers+1 entries)
+extern int *rank;
+extern int *state;
 
 
 //  Some constants
@@ -63,9 +66,58 @@ extern int state[MAX_SIZE];
 
 
 //  Integer value indicating, whether we were are respawned or not
+extern int respawned;
 extern int maxworkers;
 extern int masterrank;
 
+//  Number of slices in the bag
+extern int nslices;
+
+//  Batching: at most maxbatch slices per message, and up to prefetch
+//  messages in flight per worker; with adaptive, the batch size follows
+//  the measured slice duration and round trip time (up to maxbatch)
+extern int maxbatch;
+extern int prefetch;
+extern int adaptive;
+
+//  Synthetic slice duration in microseconds (busy wait): the mean of
+//  the distribution taskdist, and less output
+#define DIST_CONST			0
+#define DIST_EXP			1
+#define DIST_PARETO			2
+#define PARETO_SHAPE		1.5
+extern double taskusec;
+extern int taskdist;
+extern int quiet;
+
+//  Benchmark: the master reports the slices done every interval
+//  seconds (0: never); with a kill schedule (killsched), this process
+//  dies killat seconds after starttime (-1: never)
+extern double interval;
+extern int killsched;
+extern double killat;
+extern double starttime;
+
+//  Two level mode: groups of groupsize workers led by a sub-master,
+//  which pulls chunks of chunksize slices from the root (0: flat mode,
+//  GROUPS_NODE: one group per node)
+#define GROUPS_NODE   -1
+extern int groupsize;
+extern int chunksize;
+
+//  Work stealing mode (no master), and the number of ranks it kills
+extern int stealing;
+extern int nkills;
+
+//  Standby masters: the last nreplicas workers hold a copy of the
+//  slices done, and one of them takes over if the master dies (shrink
+//  mode); with killmaster, the master dies halfway through
+extern int nreplicas;
+extern int killmaster;
+
+//  Re-growth (shrink mode): replace the dead workers with new processes
+extern int respawn;
+
 //  The main communicator
 extern MPI_Comm comm;
 
@@ -73,8 +125,31 @@ extern MPI_Comm comm;
 //  The functions
 void master(void);
 void worker(void);
+void hierarchy(void);
+void steal(void);
 void error_handler(MPI_Comm *comm, int *error_code, ...);
 
 
 void mark_error(int r);
 void mark_dead(int r);
+void remap_worker(int newr, int oldr);
+
+void replica_init(void);
+void replica_update(void);
+void replica_push(int *ids, double *results, int n);
+void replica_fini(void);
+int replica_recv(int finished);
+int replica_done(int workid);
+int replica_ndone(void);
+double replica_result(void);
+void replica_suspect(void);
+double replica_takeover_time(void);
+int replica_failover(MPI_Comm *pcomm);
+
+void regrow_init(char **argv);
+int regrow_join(void);
+void regrow_update(void);
+void regrow_progress(void);
+int regrow_ready(int *grower);
+int regrow_merge(MPI_Comm *pcomm, int grower);
+void regrow_fini(void);
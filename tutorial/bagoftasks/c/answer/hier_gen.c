@@ -0,0 +1,621 @@
+/*
+ *   Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                           of Tennessee Research Foundation.  All rights
+ *                           reserved.
+ *   $COPYRIGHT$
+ *
+ *   Additional copyrights may follow
+ *
+ *   $HEADER$
+ */
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  the two level bag of tasks
+ *
+ *  The workers are split in groups: one per node (the processes that
+ *  share memory, MPI_Comm_split_type) with '-g node', or blocks of
+ *  'groupsize' consecutive ranks to emulate nodes. The first rank of
+ *  each group is its sub-master: it pulls chunks of
+ *  'chunksize' slices from the root (rank 0), hands them out slice by
+ *  slice to the workers of its group, and reports the result of each
+ *  chunk to the root when it is done. The root only sees one message
+ *  per chunk and per sub-master, whatever the number of workers.
+ *
+ *  When a worker fails, its sub-master puts its slice back in the
+ *  chunk. When a sub-master fails, the root puts its chunks back in
+ *  the bag, and the workers of the group, which all wait for it, agree
+ *  (MPIX_Comm_agree) that the group is not finished, shrink the group,
+ *  and the first survivor becomes the new sub-master. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <mpi.h>
+#include <mpi-ext.h>
+#include "fsolvergen.h"
+
+#define ROOT          0
+#define GROUP(r)      (gof[r])
+
+//      kinds of messages to the root (first value, followed by the
+//      chunk and its result)
+#define CHUNK_REQ     0.0
+#define CHUNK_DONE    1.0
+#define GROUP_DONE    2.0
+
+static MPI_Comm lcomm = MPI_COMM_NULL;    // my group
+static int myrank;
+static double compute_slice(int slice);
+
+//      root side: the chunks, and the bag of chunks not done
+static int nchunks;
+static int *cstate = NULL;       // WNOTDONE, WINPROGRESS, WDONE
+static int *cowner = NULL;       // sub-master computing the chunk
+static int *cqueue = NULL;
+static int cqhead  = 0;
+static int cqcount = 0;
+static int *dead   = NULL;       // failures already handled, per rank
+static int *galive = NULL;       // members not known dead, per group
+static int *gdone  = NULL;       // the group told us it is finished
+static int *parked = NULL;       // sub-masters waiting for a chunk
+static int nparked = 0;
+static int ndone   = 0;
+static int ngroups = 0;
+static int ngroupsleft = 0;
+static int *gof = NULL;          // group of each rank (all processes)
+static int gmax = 0;             // size of the largest group
+static int groups(MPI_Comm *plcomm);
+static void root(void);
+static void root_serve(int s);
+static void root_failures(void);
+
+//      sub-master side: the slices of my chunks, and my workers
+static int *lstate = NULL;       // AVAILABLE, WORKING, DEAD
+static int *lslice = NULL;
+static double *lres = NULL;
+static int *lqueue = NULL;       // slices of dead workers
+static int nq = 0;
+static int next, end;            // slices of the last chunk not given out
+static int *cid = NULL;          // chunks being computed by the group
+static int *cleft = NULL;
+static double *csum = NULL;
+static int nslots;
+static int submaster(void);
+static void new_chunk(int c);
+static int take_slice(int *slice);
+static void account(int slice, double result);
+static void root_failed(void);
+
+static int hworker(void);
+static void scheduled_kill(void);
+
+
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: everybody enters here. The root serves chunks; the others
+ *  are sub-master or worker in their group, until the group agrees that
+ *  it is finished. */
+void hierarchy(void) {
+   int rc, lrank, done;
+   double msg[3] = { GROUP_DONE, 0.0, 0.0 };
+   MPI_Comm newcomm;
+
+   MPI_Comm_rank(comm, &myrank);
+   MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN);
+   groups(&lcomm);
+   starttime = MPI_Wtime();
+   if(ROOT == myrank) {
+      root();
+      free(gof);
+      return;
+   }
+   MPI_Comm_set_errhandler(lcomm, MPI_ERRORS_RETURN);
+
+   while(1) {
+      MPI_Comm_rank(lcomm, &lrank);
+      if(0 == lrank) {
+         done = submaster();
+      }
+      else {
+         done = hworker();
+      }
+
+//      the group is finished when all its members got FINISH from the
+//      sub-master; if it failed, some (or all) did not. The flag is
+//      agreed upon by the survivors even if the agreement reports a
+//      failure, so that error can be ignored.
+      MPIX_Comm_failure_ack(lcomm);
+      rc = MPIX_Comm_agree(lcomm, &done);
+      if(MPI_SUCCESS != rc) {
+         printf("G%02d/R%02d: ERRORCODE %d during the agreement\n", GROUP(myrank), myrank, rc);
+      }
+      if(done) {
+         break;
+      }
+
+//      elect a new sub-master: the survivors agree on the new group,
+//      and the first of them leads it
+      rc = MPIX_Comm_shrink(lcomm, &newcomm);
+      if(MPI_SUCCESS != rc) {
+         printf("G%02d/R%02d: could not shrink the group; calling abort...\n", GROUP(myrank), myrank);
+         MPI_Abort(MPI_COMM_SELF, 2);
+      }
+      MPI_Comm_free(&lcomm);
+      lcomm = newcomm;
+      MPI_Comm_set_errhandler(lcomm, MPI_ERRORS_RETURN);
+      MPI_Comm_rank(lcomm, &lrank);
+      if(0 == lrank) {
+         printf("G%02d/R%02d: I am the new sub-master\n", GROUP(myrank), myrank);
+      }
+   }
+
+//      every member tells the root, in case the others die meanwhile
+   MPI_Send(msg, 3, MPI_DOUBLE, ROOT, CHUNK_TAG, comm);
+   MPI_Comm_free(&lcomm);
+   free(gof);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: build the groups, before any failure. Each group is named
+ *  after its lowest rank, which all the processes learn, and numbered
+ *  0, 1... in that order; the root is in none. Returns the number of
+ *  groups; the chunks are as large as the largest group by default. */
+static int groups(MPI_Comm *plcomm) {
+   MPI_Comm ncomm;
+   int r, size, color, *first;
+
+   MPI_Comm_size(comm, &size);
+   if(0 < groupsize) {
+      color = 1 + (myrank - 1) / groupsize * groupsize;
+   }
+   else {
+      //      the lowest rank of my node, other than the root
+      MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, myrank, MPI_INFO_NULL, &ncomm);
+      color = (ROOT == myrank)? size: myrank;
+      MPI_Allreduce(MPI_IN_PLACE, &color, 1, MPI_INT, MPI_MIN, ncomm);
+      MPI_Comm_free(&ncomm);
+   }
+   if(ROOT == myrank) {
+      color = MPI_UNDEFINED;
+   }
+   gof   = (int*)malloc(size * sizeof(int));
+   first = (int*)malloc(size * sizeof(int));
+   MPI_Allgather(&color, 1, MPI_INT, gof, 1, MPI_INT, comm);
+   MPI_Comm_split(comm, color, myrank, plcomm);
+
+   gof[ROOT] = -1;
+   ngroups = gmax = 0;
+   for(r = 1; r < size; r++) {
+      if(gof[r] == r) first[r] = ngroups++;
+      gof[r] = first[gof[r]];
+   }
+   //      the size of each group, for the largest one
+   for(r = 0; r < size; r++) {
+      first[r] = 0;
+   }
+   for(r = 1; r < size; r++) {
+      if(++first[gof[r]] > gmax) gmax = first[gof[r]];
+   }
+   free(first);
+   if(0 == chunksize) {
+      chunksize = gmax;
+   }
+   return ngroups;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: the root. Sub-masters ask for chunks and report the chunks
+ *  they finished, all on one ANY_SOURCE reception; a failure anywhere
+ *  interrupts it, and the chunks of the dead are put back in the bag. */
+static void root(void) {
+   int rc, i, c, s, size, eclass, ngot;
+   double msg[3], result, start, now;
+   MPI_Request req;
+   MPI_Status status;
+
+   MPI_Comm_size(comm, &size);
+   nchunks = (nslices + chunksize - 1) / chunksize;
+   cstate  = (int*)malloc(nchunks * sizeof(int));
+   cowner  = (int*)malloc(nchunks * sizeof(int));
+   cqueue  = (int*)malloc(nchunks * sizeof(int));
+   dead    = (int*)calloc(size, sizeof(int));
+   parked  = (int*)malloc(size * sizeof(int));
+   galive  = (int*)calloc(ngroups, sizeof(int));
+   gdone   = (int*)calloc(ngroups, sizeof(int));
+   for(c = 0; c < nchunks; c++) {
+      cstate[c] = WNOTDONE;
+      cowner[c] = MPI_PROC_NULL;
+      cqueue[c] = c;
+   }
+   cqhead  = 0;
+   cqcount = nchunks;
+   for(i = 1; i < size; i++) {
+      galive[GROUP(i)]++;
+   }
+   ngroupsleft = ngroups;
+   result = 0.0;
+   printf("MASTER: %d groups of up to %d workers, %d chunks of %d slices\n",
+          ngroups, gmax, nchunks, chunksize);
+
+   start = MPI_Wtime();
+   MPI_Irecv(msg, 3, MPI_DOUBLE, MPI_ANY_SOURCE, CHUNK_TAG, comm, &req);
+   while(0 < ngroupsleft) {
+      rc = MPI_Wait(&req, &status);
+      if(MPI_SUCCESS != rc) {
+         MPI_Error_class(rc, &eclass);
+         if(MPIX_ERR_PROC_FAILED != eclass
+         && MPIX_ERR_PROC_FAILED_PENDING != eclass) {
+            printf("MASTER: ERRORCODE %d while waiting for the sub-masters\n", rc);
+            MPI_Abort(comm, rc);
+         }
+         root_failures();
+         //      the reception is still pending, unless it failed
+         if(MPIX_ERR_PROC_FAILED == eclass) {
+            MPI_Irecv(msg, 3, MPI_DOUBLE, MPI_ANY_SOURCE, CHUNK_TAG, comm, &req);
+         }
+         continue;
+      }
+      s = status.MPI_SOURCE;
+
+      if(GROUP_DONE == msg[0]) {
+         if(!gdone[GROUP(s)]) {
+            gdone[GROUP(s)] = 1;
+            if(0 < galive[GROUP(s)]) ngroupsleft--;
+         }
+      }
+      else if(CHUNK_DONE == msg[0]) {
+         //      the chunk may have been given again to someone else if
+         //      the root thought this sub-master was dead: first wins
+         c = (int)msg[1];
+         if(WDONE != cstate[c]) {
+            cstate[c] = WDONE;
+            result    = result + msg[2];
+            ndone     = ndone + 1;
+            if(!quiet) {
+               printf("MASTER: DONE CHUNK: [R%02d:C%04d]\n", s, c);
+            }
+         }
+         //      last chunk: release those who wait for work
+         if(nchunks == ndone) {
+            while(0 < nparked) {
+               root_serve(parked[--nparked]);
+            }
+         }
+      }
+      else {
+         root_serve(s);
+      }
+      MPI_Irecv(msg, 3, MPI_DOUBLE, MPI_ANY_SOURCE, CHUNK_TAG, comm, &req);
+   }
+   MPI_Cancel(&req);
+   MPI_Wait(&req, MPI_STATUS_IGNORE);
+
+   ngot = 0;
+   for(c = 0; c < nchunks; c++) {
+      if(WDONE == cstate[c]) {
+         ngot += (c == nchunks-1)? nslices - c*chunksize: chunksize;
+      }
+   }
+   if(ngot < nslices) {
+      printf("MASTER: There are %d slices left to calculate\n", nslices - ngot);
+   }
+   printf("MASTER: finished, result found = %g\n", result);
+   now = MPI_Wtime() - start;
+   printf("MASTER: THROUGHPUT %d slices in %g s, %g slices/s (%d groups of up to %d, chunks of %d)\n",
+          ngot, now, ngot / now, ngroups, gmax, chunksize);
+
+   free(cstate); free(cowner); free(cqueue); free(dead);
+   free(parked); free(galive); free(gdone);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: sub-master s asks for a chunk. When the bag is empty but
+ *  chunks are still in progress, s waits: a failure may put some back. */
+static void root_serve(int s) {
+   int rc, c = FINISH;
+
+   while(0 < cqcount) {
+      c = cqueue[cqhead];
+      cqhead = (cqhead + 1) % nchunks;
+      cqcount--;
+      if(WDONE != cstate[c]) break;
+      c = FINISH;
+   }
+   if(FINISH == c && nchunks != ndone) {
+      parked[nparked++] = s;
+      return;
+   }
+   rc = MPI_Send(&c, 1, MPI_INT, s, REPLY_TAG, comm);
+   if(FINISH == c) {
+      return;
+   }
+   cstate[c] = WINPROGRESS;
+   cowner[c] = s;
+   if(!quiet) {
+      printf("MASTER: SENT CHUNK: [R%02d:C%04d]\n", s, c);
+   }
+   if(MPI_SUCCESS != rc) {
+      root_failures();
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: acknowledge the failures, and put the chunks of the failed
+ *  sub-masters back in front of the bag */
+static void root_failures(void) {
+   int i, c, r, nf, size, j;
+   MPI_Group w_group, f_group;
+   int *f_group_rank, *w_group_rank;
+
+   MPIX_Comm_failure_ack(comm);
+   MPIX_Comm_failure_get_acked(comm, &f_group);
+   MPI_Comm_group(comm, &w_group);
+   MPI_Group_size(f_group, &nf);
+   MPI_Comm_size(comm, &size);
+   f_group_rank = (int*)malloc(nf * sizeof(int));
+   w_group_rank = (int*)malloc(nf * sizeof(int));
+   for(i = 0; i < nf; i++) f_group_rank[i] = i;
+   MPI_Group_translate_ranks(f_group, nf, f_group_rank, w_group, w_group_rank);
+   MPI_Group_free(&f_group);
+   MPI_Group_free(&w_group);
+
+   for(i = 0; i < nf; i++) {
+      r = w_group_rank[i];
+      if(MPI_UNDEFINED == r || ROOT == r || dead[r]) continue;
+      dead[r] = 1;
+      printf("MASTER: R%02d of group %d has failed\n", r, GROUP(r));
+      if(0 == --galive[GROUP(r)] && !gdone[GROUP(r)]) {
+         ngroupsleft--;
+      }
+      for(c = 0; c < nchunks; c++) {
+         if(WINPROGRESS == cstate[c] && r == cowner[c]) {
+            printf("MASTER: chunk C%04d is back in the bag\n", c);
+            cstate[c] = WNOTDONE;
+            cowner[c] = MPI_PROC_NULL;
+            cqhead = (cqhead + nchunks - 1) % nchunks;
+            cqueue[cqhead] = c;
+            cqcount++;
+         }
+      }
+      for(j = 0; j < nparked; j++) {
+         if(r == parked[j]) parked[j--] = parked[--nparked];
+      }
+   }
+   free(f_group_rank); free(w_group_rank);
+
+   //      the chunks back in the bag are for those who wait
+   while(0 < nparked && 0 < cqcount) {
+      root_serve(parked[--nparked]);
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: the sub-master, with its own loop: it hands out the slices
+ *  of the chunks it pulls from the root one by one to its workers, and
+ *  requests a new chunk as soon as all the slices of the current one
+ *  are given out. Returns
+ *  once all the workers of the group got FINISH. */
+static int submaster(void) {
+   int rc, w, idx, slice, reply, working, nw, lsize, finish, nchunksgot;
+   double msg[3] = { CHUNK_REQ, 0.0, 0.0 };
+   MPI_Request *lreqs;
+
+   MPI_Comm_size(lcomm, &lsize);
+   nw     = lsize - 1;
+   nslots = lsize + 1;
+   lstate = (int*)malloc(lsize * sizeof(int));
+   lslice = (int*)malloc(lsize * sizeof(int));
+   lres   = (double*)malloc(lsize * sizeof(double));
+   lqueue = (int*)malloc(lsize * sizeof(int));
+   cid    = (int*)malloc(nslots * sizeof(int));
+   cleft  = (int*)malloc(nslots * sizeof(int));
+   csum   = (double*)malloc(nslots * sizeof(double));
+//      index 0 is the reply of the root, the others the results
+   lreqs  = (MPI_Request*)malloc(lsize * sizeof(MPI_Request));
+   for(w = 0; w < lsize; w++) {
+      lstate[w] = AVAILABLE;
+      lreqs[w]  = MPI_REQUEST_NULL;
+   }
+   for(w = 0; w < nslots; w++) {
+      cid[w] = NULLWORKID;
+   }
+   nq = 0; next = end = 0;
+   working = 0; finish = 0; nchunksgot = 0;
+
+   while(!finish || 0 < working) {
+      //      ask the root for the next chunk when all slices are out
+      if(!finish && MPI_REQUEST_NULL == lreqs[0] && 0 == nq && next == end) {
+         rc = MPI_Send(msg, 3, MPI_DOUBLE, ROOT, CHUNK_TAG, comm);
+         if(MPI_SUCCESS != rc) root_failed();
+         MPI_Irecv(&reply, 1, MPI_INT, ROOT, REPLY_TAG, comm, &lreqs[0]);
+      }
+
+      //      give a slice to every worker without one
+      for(w = 1; w < lsize; w++) {
+         if(AVAILABLE != lstate[w] || !take_slice(&slice)) continue;
+         rc = MPI_Send(&slice, 1, MPI_INT, w, WORK_TAG, lcomm);
+         if(MPI_SUCCESS != rc) {
+            printf("G%02d/R%02d: worker %d of the group has failed\n", GROUP(myrank), myrank, w);
+            lstate[w] = DEAD; nw--;
+            lqueue[nq++] = slice;
+            continue;
+         }
+         lstate[w] = WORKING;
+         lslice[w] = slice;
+         working++;
+         MPI_Irecv(&lres[w], 1, MPI_DOUBLE, w, RES_TAG, lcomm, &lreqs[w]);
+      }
+      //      no worker left in the group: do the work myself
+      if(0 == nw) {
+         while(take_slice(&slice)) account(slice, compute_slice(slice));
+      }
+
+      rc = MPI_Waitany(lsize, lreqs, &idx, MPI_STATUS_IGNORE);
+      scheduled_kill();
+      if(MPI_UNDEFINED == idx) continue;
+      if(0 == idx) {
+         if(MPI_SUCCESS != rc) root_failed();
+         if(FINISH == reply) {
+            finish = 1;
+            continue;
+         }
+         new_chunk(reply);
+//---------------------Inject Abort!-------------------------
+         if(!killsched && 1 == myrank && 2 == ++nchunksgot) {
+            printf("G%02d/R%02d: CRASHING myself\n", GROUP(myrank), myrank);
+            exit(-1);
+         }
+//----------------------------------------------------------
+         continue;
+      }
+      if(MPI_SUCCESS != rc) {
+         printf("G%02d/R%02d: ERRORCODE %d, worker %d of the group has failed\n", GROUP(myrank), myrank, rc, idx);
+         lstate[idx] = DEAD; nw--;
+         working--;
+         lqueue[nq++] = lslice[idx];
+         continue;
+      }
+      lstate[idx] = AVAILABLE;
+      working--;
+      account(lslice[idx], lres[idx]);
+   }
+
+   //      release the workers
+   slice = FINISH;
+   for(w = 1; w < lsize; w++) {
+      if(AVAILABLE == lstate[w]) {
+         MPI_Send(&slice, 1, MPI_INT, w, WORK_TAG, lcomm);
+      }
+   }
+   free(lstate); free(lslice); free(lres); free(lqueue);
+   free(cid); free(cleft); free(csum); free(lreqs);
+   return 1;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ **********************************************************************/
+static void new_chunk(int c) {
+   int i;
+
+   for(i = 0; NULLWORKID != cid[i]; i++);
+   next = c * chunksize;
+   end  = (next + chunksize < nslices)? next + chunksize: nslices;
+   cid[i]   = c;
+   cleft[i] = end - next;
+   csum[i]  = 0.0;
+   if(!quiet) {
+      printf("G%02d/R%02d: GOT CHUNK: [C%04d]\n", GROUP(myrank), myrank, c);
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: slices of dead workers first, then the rest of the chunk */
+static int take_slice(int *slice) {
+   if(0 < nq) {
+      *slice = lqueue[--nq];
+      return 1;
+   }
+   if(next < end) {
+      *slice = next++;
+      return 1;
+   }
+   return 0;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: add the result of a slice to its chunk, and report the
+ *  chunk to the root when it is complete */
+static void account(int slice, double result) {
+   int i, rc;
+   double msg[3];
+
+   for(i = 0; slice / chunksize != cid[i]; i++);
+   csum[i] = csum[i] + result;
+   if(0 == --cleft[i]) {
+      msg[0] = CHUNK_DONE;
+      msg[1] = cid[i];
+      msg[2] = csum[i];
+      cid[i] = NULLWORKID;
+      rc = MPI_Send(msg, 3, MPI_DOUBLE, ROOT, CHUNK_TAG, comm);
+      if(MPI_SUCCESS != rc) root_failed();
+   }
+}
+
+static void root_failed(void) {
+   printf("G%02d/R%02d: Looks like the root has failed; calling abort...\n", GROUP(myrank), myrank);
+   MPI_Abort(MPI_COMM_SELF, 2);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: a worker of the group. Returns 1 when the sub-master says
+ *  FINISH, 0 when it has failed. */
+static int hworker(void) {
+   int rc, slice;
+   double result;
+
+   while(1) {
+      rc = MPI_Recv(&slice, 1, MPI_INT, 0, WORK_TAG, lcomm, MPI_STATUS_IGNORE);
+      if(MPI_SUCCESS != rc) {
+         printf("G%02d/R%02d: ERRORCODE %d while RECV WORK, the sub-master has failed\n", GROUP(myrank), myrank, rc);
+         return 0;
+      }
+      if(FINISH == slice) {
+         return 1;
+      }
+      result = compute_slice(slice);
+      scheduled_kill();
+      rc = MPI_Send(&result, 1, MPI_DOUBLE, 0, RES_TAG, lcomm);
+      if(MPI_SUCCESS != rc) {
+         printf("G%02d/R%02d: ERRORCODE %d while RETURN WORK, the sub-master has failed\n", GROUP(myrank), myrank, rc);
+         return 0;
+      }
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: with a kill schedule (-K), die when the time has come */
+static void scheduled_kill(void) {
+//---------------------Inject Abort!-------------------------
+   if(0.0 <= killat && MPI_Wtime() - starttime >= killat) {
+      printf("G%02d/R%02d: CRASHING myself at %g s, as scheduled\n", GROUP(myrank), myrank, MPI_Wtime() - starttime);
+      exit(-1);
+   }
+//----------------------------------------------------------
+}
+
+/***********************************************************************
+ ***********************************************************************
+ **********************************************************************/
+static double compute_slice(int slice) {
+   double width, x, y, start;
+
+   start = MPI_Wtime();
+   width = 1.0 / nslices;
+   x = width * slice;
+   y = 4.0 / (1.0 + x*x);
+   while(MPI_Wtime() - start < taskusec * 1e-6);
+   return y * width;
+}
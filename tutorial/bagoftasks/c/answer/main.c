@@ -35,15 +35,112 @@
 #include <mpi.h>
 #include <mpi-ext.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
 #include "fsolvergen.h"
 
 /* some globals */
 int maxworkers = 0;
 int masterrank = 0;
+int nslices = 0;
+int maxbatch = 1;
+int prefetch = 1;
+int adaptive = 0;
+double taskusec = 0.0;
+int taskdist = DIST_CONST;
+double interval = 0.0;
+int killsched = 0;
+double killat = -1.0;
+double starttime = 0.0;
+int quiet = 0;
+int groupsize = 0;
+int chunksize = 0;
+int stealing = 0;
+int nkills = 0;
+int nreplicas = 0;
+int killmaster = 0;
+int respawn = 0;
+int respawned = 0;
 MPI_Comm comm = MPI_COMM_NULL;
 
+/* The kill schedule, "rank@seconds,...": when do I die? */
+static void parse_kills(char *spec, int myrank) {
+  char *copy, *pair, *at;
+
+  if(!strcmp(spec, "none")) {
+    return;
+  }
+  copy = strdup(spec);
+  for(pair = strtok(copy, ","); NULL != pair; pair = strtok(NULL, ",")) {
+    at = strchr(pair, '@');
+    if(NULL == at || 0.0 > atof(at+1)) {
+      killat = -2.0; /* invalid */
+      break;
+    }
+    if(atoi(pair) == myrank) {
+      killat = atof(at+1);
+    }
+  }
+  free(copy);
+}
+
+static void usage(char *name) {
+  printf("Usage: %s [options] [nslices]\n"
+         "  -b, --batch <n>       at most n slices per work message (default 1)\n"
+         "  -k, --prefetch <n>    up to n work messages in flight per worker (default 1)\n"
+         "  -a, --adaptive        size batches from the measured slice and round trip\n"
+         "                        times, up to --batch slices\n"
+         "  -t, --taskusec <us>   make each slice last us microseconds on average\n"
+         "                        (default 0)\n"
+         "  -d, --dist <d>        distribution of the slice durations: const\n"
+         "                        (default), exp or pareto (heavy tailed)\n"
+         "  -K, --kill <r@s,...>  world rank r dies s seconds after the start, for\n"
+         "                        each pair, in every mode; none: no failure\n"
+         "                        (default: rank 1 dies after 2 slices, or after\n"
+         "                        2 chunks in two level mode; none with --steal)\n"
+         "  -i, --interval <s>    report the slices done every s seconds\n"
+         "  -q, --quiet           do not report every slice sent and done\n"
+         "  -g, --groupsize <n>   two level mode: sub-masters leading a group per\n"
+         "                        node (n = node), or groups of n consecutive ranks\n"
+         "                        (emulated nodes), pull chunks of slices from the\n"
+         "                        master\n"
+         "  -c, --chunk <n>       slices per chunk in two level mode (default: the\n"
+         "                        size of the largest group)\n"
+         "  -w, --steal           no master: all processes work and steal work\n"
+         "                        from each other\n"
+         "  -f, --failures <n>    in work stealing mode, the last n processes die\n"
+         "                        one after the other (default 0)\n"
+         "  -r, --replicas <n>    n workers are standby masters, one of them takes\n"
+         "                        over if the master dies (shrink mode, default 0)\n"
+         "  -x, --kill-master     the master dies after half of the slices\n"
+         "  -s, --spawn           spawn new workers to replace the dead ones\n"
+         "                        (shrink mode)\n"
+         "  -h, --help            this message\n", name);
+}
+
 int main(int argc, char *argv[]) {
   int myrank = MPI_PROC_NULL, size = 0, rc = MPI_SUCCESS;
+  int c;
+  struct option long_options[] = {
+    { "batch",     required_argument, 0, 'b' },
+    { "prefetch",  required_argument, 0, 'k' },
+    { "adaptive",  no_argument,       0, 'a' },
+    { "taskusec",  required_argument, 0, 't' },
+    { "dist",      required_argument, 0, 'd' },
+    { "kill",      required_argument, 0, 'K' },
+    { "interval",  required_argument, 0, 'i' },
+    { "quiet",     no_argument,       0, 'q' },
+    { "groupsize", required_argument, 0, 'g' },
+    { "chunk",     required_argument, 0, 'c' },
+    { "steal",     no_argument,       0, 'w' },
+    { "failures",  required_argument, 0, 'f' },
+    { "replicas",  required_argument, 0, 'r' },
+    { "kill-master", no_argument,     0, 'x' },
+    { "spawn",     no_argument,       0, 's' },
+    { "help",      no_argument,       0, 'h' },
+    { 0, 0, 0, 0 }
+  };
 
   MPI_Init(&argc, &argv);
   MPI_Comm_rank(MPI_COMM_WORLD, &myrank);
@@ -53,18 +150,93 @@ int main(int argc, char *argv[]) {
 
   /* Create my own communicator to play with */
   MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+  regrow_init(argv);
 
   maxworkers = size-1;
-  if(masterrank == myrank) {
-    if(size > MAX_SIZE) {
-      printf("This program can use a maximum %d processes.", MAX_SIZE);
-      MPI_Abort(MPI_COMM_WORLD, 1);
+  while(1) {
+    c = getopt_long(argc, argv, "b:k:at:d:K:i:qg:c:wf:r:xsh", long_options, NULL);
+    if(-1 == c) break;
+    switch(c) {
+    case 'b': maxbatch = atoi(optarg); break;
+    case 'k': prefetch = atoi(optarg); break;
+    case 'a': adaptive = 1; break;
+    case 't': taskusec = atof(optarg); break;
+    case 'd':
+      if(!strcmp(optarg, "const")) taskdist = DIST_CONST;
+      else if(!strcmp(optarg, "exp")) taskdist = DIST_EXP;
+      else if(!strcmp(optarg, "pareto")) taskdist = DIST_PARETO;
+      else taskdist = -1;
+      break;
+    case 'K': killsched = 1; parse_kills(optarg, myrank); break;
+    case 'i': interval = atof(optarg); break;
+    case 'q': quiet = 1; break;
+    case 'g': groupsize = strcmp(optarg, "node")? atoi(optarg): GROUPS_NODE; break;
+    case 'c': chunksize = atoi(optarg); break;
+    case 'w': stealing = 1; break;
+    case 'f': nkills = atoi(optarg); break;
+    case 'r': nreplicas = atoi(optarg); break;
+    case 'x': killmaster = 1; break;
+    case 's': respawn = 1; break;
+    case 'h':
+    default:
+      if(masterrank == myrank) usage(argv[0]);
+      MPI_Finalize();
+      return 0;
     }
-    printf("MASTER: I am R%02d and I will manage %d workers\n", myrank, maxworkers);
-    master();
+  }
+  /* The number of slices can be given on the command line */
+  nslices = size * SLICES_PER_PROC;
+  if(argc > optind) {
+    nslices = atoi(argv[optind]);
+  }
+  if(0 == chunksize && 0 < groupsize) {
+    chunksize = groupsize;
+  }
+  /* A replacement worker joins the others, if it is not too late */
+  if(regrow_join()) {
+    if(MPI_COMM_NULL != comm) {
+      worker();
+    }
+    MPI_Finalize();
+    return 0;
+  }
+  if(0 >= nslices || 0 >= maxbatch || 0 >= prefetch || 0.0 > taskusec
+  || (0 > groupsize && GROUPS_NODE != groupsize) || 0 > chunksize
+  || 0 > nkills || nkills >= size || 0 > nreplicas || nreplicas >= size
+  || 0 > taskdist || 0.0 > interval || -2.0 == killat) {
+    if(masterrank == myrank) printf("Invalid parameters: %d slices, batch %d, prefetch %d, %g us per slice\n",
+                                    nslices, maxbatch, prefetch, taskusec);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  if(stealing) {
+    if(masterrank == myrank) {
+      printf("STEAL: %d processes steal work from each other for %d slices\n", size, nslices);
+    }
+    steal();
+  }
+  else if(0 != groupsize) {
+    if(masterrank == myrank) {
+      printf("MASTER: I am R%02d and I will manage %d workers for %d slices\n", myrank, maxworkers, nslices);
+    }
+    hierarchy();
   }
   else {
-    worker();
+    replica_init();
+    MPI_Barrier(comm);
+    starttime = MPI_Wtime();
+    if(masterrank == myrank) {
+      printf("MASTER: I am R%02d and I will manage %d workers for %d slices\n", myrank, maxworkers, nslices);
+      printf("MASTER: batches of %s%d slices, %d batches in flight per worker, %d standby masters\n",
+             adaptive? "up to ": "", maxbatch, prefetch, nreplicas);
+    }
+    else {
+      worker();
+      /* a standby leaves the worker loop to take over */
+      MPI_Comm_rank(comm, &myrank);
+    }
+    if(masterrank == myrank) {
+      master();
+    }
   }
   
   MPI_Finalize();
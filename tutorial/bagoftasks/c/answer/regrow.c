@@ -0,0 +1,286 @@
+/*
+ *   Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                           of Tennessee Research Foundation.  All rights
+ *                           reserved.
+ *   $COPYRIGHT$
+ *
+ *   Additional copyrights may follow
+ *
+ *   $HEADER$
+ */
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  re-growth of the workers (shrink mode)
+ *
+ *  After each shrink, one worker (the grower, rank 1) is told how many
+ *  processes are missing. Between two batches, it spawns them alone
+ *  (over MPI_COMM_SELF), and keeps them waiting in a bridge
+ *  communicator; only then it tells the master, which has kept
+ *  dispatching work to the others meanwhile.
+ *
+ *  The master then stops giving new batches, and once all the results
+ *  are in, it sends a GROW message to every worker: they all build an
+ *  intercommunicator with the new processes, through the bridge, and
+ *  merge it. The old processes come first in the merged communicator,
+ *  so they keep their ranks, and the new ones are numbered after them.
+ *  If a process fails meanwhile, all agree to give up, and the usual
+ *  shrink takes place instead. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include <mpi-ext.h>
+#include "fsolvergen.h"
+
+#define GROW_TAG      800
+#define NINFO         6              // go, nominal, and the options of the run
+
+static char **gargv = NULL;
+static int nominal = 0;              // number of processes to keep
+static int amgrower = 0;
+static int nspawn = 0;               // grower: processes to spawn
+static int announce = 0;             // grower: the master must be told
+static MPI_Comm bridge = MPI_COMM_NULL;   // grower and its spawnees
+static int nbridge = 0;
+static int merge(MPI_Comm local, int leader, MPI_Comm peer, int rleader,
+                 int high, MPI_Comm *newcomm);
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: the spawnees get the same arguments */
+void regrow_init(char **argv) {
+   gargv = argv;
+   MPI_Comm_size(MPI_COMM_WORLD, &nominal);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: in a spawnee, wait until the workers merge with us, and
+ *  set comm. Returns 0 if this is not a spawnee; comm is
+ *  MPI_COMM_NULL if the run ended before we could join. The slices,
+ *  their cost and the batch size are those of the master, not what we
+ *  computed from our own (smaller) MPI_COMM_WORLD. */
+int regrow_join(void) {
+   MPI_Comm parent, newcomm;
+   double info[NINFO];
+   int rc;
+
+   MPI_Comm_get_parent(&parent);
+   if(MPI_COMM_NULL == parent) {
+      return 0;
+   }
+   respawned = 1;
+   MPI_Intercomm_merge(parent, 1, &bridge);
+   MPI_Comm_free(&parent);
+   MPI_Comm_free(&comm);
+   comm = MPI_COMM_NULL;
+
+   //     the grower is 0 in the bridge, and tells us when to go
+   MPI_Bcast(info, NINFO, MPI_DOUBLE, 0, bridge);
+   if(0.0 != info[0]) {
+      nslices  = (int)info[2];
+      maxbatch = (int)info[3];
+      taskdist = (int)info[4];
+      taskusec = info[5];
+      rc = merge(MPI_COMM_WORLD, 0, bridge, 0, 1, &newcomm);
+      if(MPI_SUCCESS == rc) {
+         comm    = newcomm;
+         nominal = (int)info[1];
+         MPI_Comm_size(comm, &maxworkers);
+         maxworkers = maxworkers - 1;
+      }
+   }
+   MPI_Comm_free(&bridge);
+   return 1;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: after a shrink, in the error handler: who is the grower,
+ *  and how many processes must it spawn (those it has already spawned
+ *  are still waiting to join) */
+void regrow_update(void) {
+   int myrank, size;
+
+   if(!respawn) {
+      return;
+   }
+   MPI_Comm_rank(comm, &myrank);
+   MPI_Comm_size(comm, &size);
+   amgrower = (1 < size && 1 == myrank);
+   if(amgrower) {
+      nspawn   = nominal - size - nbridge;
+      announce = (0 < nbridge);
+   }
+   else if(MPI_COMM_NULL != bridge) {
+      //     the grower moved: our spawnees will not join
+      regrow_fini();
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: in the grower, between two batches: spawn the missing
+ *  processes, and tell the master they are ready */
+void regrow_progress(void) {
+   MPI_Comm icomm;
+   int rc, myrank;
+   double start;
+
+   if(!amgrower) {
+      return;
+   }
+   if(0 < nspawn && MPI_COMM_NULL == bridge) {
+      MPI_Comm_rank(comm, &myrank);
+      start = MPI_Wtime();
+      rc = MPI_Comm_spawn(gargv[0], &gargv[1], nspawn, MPI_INFO_NULL,
+                          0, MPI_COMM_SELF, &icomm, MPI_ERRCODES_IGNORE);
+      if(MPI_SUCCESS != rc) {
+         printf("R%02d: ERRORCODE %d while spawning %d workers\n", myrank, rc, nspawn);
+         return;
+      }
+      MPI_Intercomm_merge(icomm, 0, &bridge);
+      MPI_Comm_free(&icomm);
+      printf("R%02d: spawned %d workers in %g s\n", myrank, nspawn, MPI_Wtime() - start);
+      nbridge  = nspawn;
+      nspawn   = 0;
+      announce = 1;
+   }
+   if(announce) {
+      //     a failure here runs the error handler, which announces again
+      announce = 0;
+      MPI_Send(&nbridge, 1, MPI_INT, masterrank, GROW_TAG, comm);
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: in the master: the number of processes waiting to join, and
+ *  the rank of their grower (0 if none) */
+int regrow_ready(int *grower) {
+   int flag, n = 0;
+   MPI_Status status;
+
+   if(!respawn) {
+      return 0;
+   }
+   MPI_Iprobe(MPI_ANY_SOURCE, GROW_TAG, comm, &flag, &status);
+   if(flag) {
+      MPI_Recv(&n, 1, MPI_INT, status.MPI_SOURCE, GROW_TAG, comm, MPI_STATUS_IGNORE);
+      *grower = status.MPI_SOURCE;
+   }
+   return n;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: the master, once no work is in flight, and the workers, on
+ *  the GROW message: merge with the processes waiting at the grower.
+ *  Returns the number of processes that joined; on failure, the error
+ *  handler is called on the (revoked) communicator. */
+int regrow_merge(MPI_Comm *pcomm, int grower) {
+   int rc, i, myrank, size, oldsize, msg[2];
+   double info[NINFO];
+   MPI_Comm newcomm;
+   MPI_Errhandler errh;
+
+   MPI_Comm_rank(*pcomm, &myrank);
+   MPI_Comm_size(*pcomm, &oldsize);
+   MPI_Comm_get_errhandler(*pcomm, &errh);
+   MPI_Comm_set_errhandler(*pcomm, MPI_ERRORS_RETURN);
+
+   //     the failures are dealt with after the agreement, in merge()
+   if(masterrank == myrank) {
+      msg[0] = GROW;
+      msg[1] = grower;
+      for(i = 0; i < oldsize; i++) {
+         if(masterrank == i) continue;
+         if(DEAD == state[i] || FINISHED == state[i]) continue;
+         MPI_Send(msg, 2, MPI_INT, i, WORK_TAG, *pcomm);
+      }
+   }
+   if(grower == myrank) {
+      info[0] = 1;
+      info[1] = nominal;
+      info[2] = nslices;
+      info[3] = maxbatch;
+      info[4] = taskdist;
+      info[5] = taskusec;
+      MPI_Bcast(info, NINFO, MPI_DOUBLE, 0, bridge);
+   }
+   rc = merge(*pcomm, grower, (grower == myrank)? bridge: MPI_COMM_NULL, 1, 0, &newcomm);
+   if(grower == myrank) {
+      MPI_Comm_free(&bridge);
+      nbridge = 0;
+   }
+
+   if(MPI_SUCCESS != rc) {
+      MPIX_Comm_revoke(*pcomm);
+      MPI_Comm_set_errhandler(*pcomm, errh);
+      MPI_Errhandler_free(&errh);
+      MPI_Comm_call_errhandler(*pcomm, MPIX_ERR_REVOKED);
+      return 0;
+   }
+   MPI_Comm_set_errhandler(newcomm, errh);
+   MPI_Errhandler_free(&errh);
+   MPI_Comm_free(pcomm);
+   *pcomm = newcomm;
+   MPI_Comm_size(newcomm, &size);
+   maxworkers = size - 1;
+   if(masterrank == myrank) {
+      printf("MASTER: %d new workers joined, now %d workers\n", size - oldsize, maxworkers);
+   }
+   return size - oldsize;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: the grower is done: send its spawnees home */
+void regrow_fini(void) {
+   double info[NINFO] = { 0.0 };
+
+   if(MPI_COMM_NULL != bridge) {
+      MPI_Bcast(info, NINFO, MPI_DOUBLE, 0, bridge);
+      MPI_Comm_free(&bridge);
+      nbridge = 0;
+   }
+   amgrower = 0;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: build the intercommunicator between the workers and the
+ *  spawnees, and merge it (same checks as in 10.respawn.c) */
+static int merge(MPI_Comm local, int leader, MPI_Comm peer, int rleader,
+                 int high, MPI_Comm *newcomm) {
+   MPI_Comm icomm;
+   int rc, flag, rflag;
+
+   rc = MPI_Intercomm_create(local, leader, peer, rleader, GROW_TAG, &icomm);
+   flag = (MPI_SUCCESS == rc);
+   MPIX_Comm_agree(local, &flag);
+   if(!flag) {
+      if(MPI_SUCCESS == rc) MPI_Comm_free(&icomm);
+      return MPIX_ERR_PROC_FAILED;
+   }
+   rc = MPI_Intercomm_merge(icomm, high, newcomm);
+   rflag = flag = (MPI_SUCCESS == rc);
+   MPIX_Comm_agree(local, &flag);
+   MPIX_Comm_agree(icomm, &rflag);
+   MPI_Comm_free(&icomm);
+   if(!(flag && rflag)) {
+      if(MPI_SUCCESS == rc) MPI_Comm_free(newcomm);
+      return MPIX_ERR_PROC_FAILED;
+   }
+   return MPI_SUCCESS;
+}
@@ -0,0 +1,271 @@
+/*
+ *   Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                           of Tennessee Research Foundation.  All rights
+ *                           reserved.
+ *   $COPYRIGHT$
+ *
+ *   Additional copyrights may follow
+ *
+ *   $HEADER$
+ */
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  replication of the master state
+ *
+ *  The last 'nreplicas' workers are also standby masters. Each time a
+ *  batch is done, the master streams the slices and their results to
+ *  the standbys (nonblocking sends, grouped while the previous send to a
+ *  standby is in progress). A standby applies them whenever it waits for
+ *  work, so it holds a prefix of the slices done by the master.
+ *
+ *  When the master fails (shrink mode), the survivors elect the standby
+ *  with the longest prefix, and renumber it 0 in the new communicator.
+ *  It leaves the worker loop, and master() starts from its table: only
+ *  the slices done but not replicated yet are done again. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include <mpi-ext.h>
+#include "fsolvergen.h"
+
+#define REPL_TAG      700
+
+//      standby side: the replicated table
+static int amstandby = 0;
+static char *rdone = NULL;
+static int rndone = 0;
+static double rresult = 0.0;
+static double *rbuf = NULL;
+static int rbufsize = 0;
+static double failover_start = 0.0;
+static double suspect_start = 0.0;   // first error of the current recovery
+
+//      master side: the standbys, and the deltas not sent yet to each
+static int *standby = NULL;      // ranks of the standbys
+static int nstandby = 0;
+static double **rpend = NULL;    // deltas to send: (slice, result) pairs
+static double **rsend = NULL;    // deltas being sent
+static int *npend = NULL, *mpend = NULL, *msend = NULL;
+static MPI_Request *rreq = NULL;
+static void replica_progress(void);
+
+/***********************************************************************
+ ***********************************************************************
+ **********************************************************************/
+void replica_init(void) {
+   int myrank, size;
+
+   MPI_Comm_rank(comm, &myrank);
+   MPI_Comm_size(comm, &size);
+   rdone = (char*)calloc(nslices, sizeof(char));
+   amstandby = (masterrank != myrank && myrank >= size - nreplicas);
+   replica_update();
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: (re)build the list of standbys, in the current communicator.
+ *  Deltas not sent yet are dropped: the slices they hold will be done
+ *  again if this master fails too. */
+void replica_update(void) {
+   int i, size, *flags;
+
+   for(i = 0; i < nstandby; i++) {
+      if(MPI_REQUEST_NULL != rreq[i]) MPI_Request_free(&rreq[i]);
+      free(rpend[i]); free(rsend[i]);
+   }
+   free(standby); free(rpend); free(rsend);
+   free(npend); free(mpend); free(msend); free(rreq);
+
+   suspect_start = 0.0;   // the recovery, if any, is over
+   MPI_Comm_size(comm, &size);
+   flags = (int*)malloc(size * sizeof(int));
+   MPI_Allgather(&amstandby, 1, MPI_INT, flags, 1, MPI_INT, comm);
+   for(nstandby = 0, i = 0; i < size; i++) nstandby += flags[i];
+   standby = (int*)malloc(nstandby * sizeof(int));
+   rpend   = (double**)calloc(nstandby, sizeof(double*));
+   rsend   = (double**)calloc(nstandby, sizeof(double*));
+   npend   = (int*)calloc(nstandby, sizeof(int));
+   mpend   = (int*)calloc(nstandby, sizeof(int));
+   msend   = (int*)calloc(nstandby, sizeof(int));
+   rreq    = (MPI_Request*)malloc(nstandby * sizeof(MPI_Request));
+   for(nstandby = 0, i = 0; i < size; i++) {
+      if(flags[i]) {
+         rreq[nstandby]      = MPI_REQUEST_NULL;
+         standby[nstandby++] = i;
+      }
+   }
+   free(flags);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: the master has done n slices: queue them for the standbys */
+void replica_push(int *ids, double *results, int n) {
+   int s, i;
+
+   for(s = 0; s < nstandby; s++) {
+      if(DEAD == state[standby[s]]) continue;
+      if(npend[s] + 2*n > mpend[s]) {
+         mpend[s] = 2 * (npend[s] + 2*n);
+         rpend[s] = (double*)realloc(rpend[s], mpend[s] * sizeof(double));
+      }
+      for(i = 0; i < n; i++) {
+         rpend[s][npend[s]++] = ids[i];
+         rpend[s][npend[s]++] = results[i];
+      }
+   }
+   replica_progress();
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: send the queued deltas to each standby that is done with
+ *  the previous ones */
+static void replica_progress(void) {
+   int s, flag, rc, m, n;
+   double *tmp;
+   MPI_Request req;
+   MPI_Comm sendcomm = comm;
+
+//      a failure reported here runs the error handler, which may
+//      rebuild the tables: stop if the communicator changed
+   for(s = 0; s < nstandby; s++) {
+      if(0 == npend[s] || DEAD == state[standby[s]]) continue;
+      if(MPI_REQUEST_NULL != rreq[s]) {
+         rc = MPI_Test(&rreq[s], &flag, MPI_STATUS_IGNORE);
+         if(sendcomm != comm) return;
+         if(MPI_SUCCESS != rc || !flag) continue;
+      }
+      tmp = rsend[s]; rsend[s] = rpend[s]; rpend[s] = tmp;
+      m = msend[s]; msend[s] = mpend[s]; mpend[s] = m;
+      n = npend[s]; npend[s] = 0;
+      rc = MPI_Isend(rsend[s], n, MPI_DOUBLE, standby[s], REPL_TAG, comm, &req);
+      if(sendcomm != comm) return;
+      rreq[s] = (MPI_SUCCESS == rc)? req: MPI_REQUEST_NULL;
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: the master is finished: push the last deltas out, followed
+ *  by an empty one, which tells the standbys to stop waiting for more */
+void replica_fini(void) {
+   int s;
+   MPI_Comm sendcomm = comm;
+
+   for(s = 0; s < nstandby && sendcomm == comm; s++) {
+      if(MPI_REQUEST_NULL != rreq[s]) MPI_Wait(&rreq[s], MPI_STATUS_IGNORE);
+   }
+   replica_progress();
+   for(s = 0; s < nstandby && sendcomm == comm; s++) {
+      if(DEAD == state[standby[s]]) continue;
+      if(MPI_REQUEST_NULL != rreq[s]) MPI_Wait(&rreq[s], MPI_STATUS_IGNORE);
+      if(sendcomm != comm) break;
+      MPI_Send(NULL, 0, MPI_DOUBLE, standby[s], REPL_TAG, comm);
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: a standby waiting for work applies the deltas that come
+ *  before it; once finished, it applies them until the last (empty)
+ *  one. Returns the error code of the probe, if any. */
+int replica_recv(int finished) {
+   int rc, n, i;
+   MPI_Status status;
+
+   while(amstandby) {
+      rc = MPI_Probe(masterrank, finished? REPL_TAG: MPI_ANY_TAG, comm, &status);
+      if(MPI_SUCCESS != rc) return rc;
+      if(REPL_TAG != status.MPI_TAG) break;
+      MPI_Get_count(&status, MPI_DOUBLE, &n);
+      if(n > rbufsize) {
+         rbufsize = n;
+         rbuf = (double*)realloc(rbuf, rbufsize * sizeof(double));
+      }
+      rc = MPI_Recv(rbuf, n, MPI_DOUBLE, masterrank, REPL_TAG, comm, MPI_STATUS_IGNORE);
+      if(MPI_SUCCESS != rc) return rc;
+      for(i = 0; i < n; i += 2) {
+         if(!rdone[(int)rbuf[i]]) {
+            rdone[(int)rbuf[i]] = 1;
+            rresult = rresult + rbuf[i+1];
+            rndone++;
+         }
+      }
+      if(0 == n) break;
+   }
+   return MPI_SUCCESS;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: what a new master starts from (nothing for the first one) */
+int replica_done(int workid) {
+   return rdone[workid];
+}
+
+int replica_ndone(void) {
+   return rndone;
+}
+
+double replica_result(void) {
+   return rresult;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: at the entry of the error handler: if the master turns out
+ *  to be dead, the takeover time counts from here, with the detection,
+ *  the revoke and the shrink */
+void replica_suspect(void) {
+   if(0.0 == suspect_start) {
+      suspect_start = MPI_Wtime();
+   }
+}
+
+double replica_takeover_time(void) {
+   return (0.0 == failover_start)? -1.0: MPI_Wtime() - failover_start;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: in the error handler, after the shrink, when the master is
+ *  not among the survivors: elect the standby with the most slices,
+ *  and renumber it masterrank. Returns 0 if there is no standby left. */
+int replica_failover(MPI_Comm *pcomm) {
+   struct { int n, rank; } mine, best;
+   MPI_Comm newcomm;
+   MPI_Errhandler errh;
+
+   failover_start = (0.0 != suspect_start)? suspect_start: MPI_Wtime();
+   MPI_Comm_rank(*pcomm, &mine.rank);
+   mine.n = amstandby? rndone: -1;
+   MPI_Allreduce(&mine, &best, 1, MPI_2INT, MPI_MAXLOC, *pcomm);
+   if(0 > best.n) {
+      return 0;
+   }
+   MPI_Comm_split(*pcomm, 0, (best.rank == mine.rank)? -1: mine.rank, &newcomm);
+   MPI_Comm_get_errhandler(*pcomm, &errh);
+   MPI_Comm_set_errhandler(newcomm, errh);
+   MPI_Errhandler_free(&errh);
+   MPI_Comm_free(pcomm);
+   *pcomm = newcomm;
+   if(best.rank == mine.rank) {
+      printf("R%02d: I am the new master, with %d slices done\n", mine.rank, rndone);
+      amstandby = 0;
+   }
+   return 1;
+}
@@ -0,0 +1,515 @@
+/*
+ *   Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                           of Tennessee Research Foundation.  All rights
+ *                           reserved.
+ *   $COPYRIGHT$
+ *
+ *   Additional copyrights may follow
+ *
+ *   $HEADER$
+ */
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  the bag of tasks without a master: work stealing
+ *
+ *  The slices are split in equal ranges, one per rank. Each rank works
+ *  on its ranges; when it has none left, it asks random victims for
+ *  some, and the victim gives away the top half of its first range.
+ *  Both sides log the transfer, with a version number that increases
+ *  each time a range moves.
+ *
+ *  When a rank has asked everybody in vain, it enters a nonblocking
+ *  agreement, while still answering thieves (with nothing). Ranks only
+ *  enter it once they are out of work, and work only moves by
+ *  stealing, so when all have entered the whole bag is done. A failure
+ *  makes the agreement fail instead: the rank that notices a failure
+ *  revokes the communicator and joins the agreement with 0.
+ *
+ *  The survivors then shrink the communicator; the ranks missing from
+ *  the new one are the failed group, agreed upon by the shrink. The
+ *  results of a dead rank are lost with it, so every slice it was last
+ *  responsible for must be done again. The survivors exchange their
+ *  logs: the last holder of a slice is the one that received it with
+ *  the highest version, either when the slices were assigned or from a
+ *  transfer. The slices last held by the dead are split evenly between
+ *  the survivors. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include <mpi-ext.h>
+#include "fsolvergen.h"
+
+#define STEAL_TAG     500
+#define GIVE_TAG      600
+#define STEAL_POLL    16     // slices computed between two looks for thieves
+
+//      a range of slices [lo, hi[ that moved from rank 'from' to rank
+//      'to' (ranks in the original communicator); 'seq' numbers the
+//      ranges given by 'from'
+typedef struct {
+   int lo, hi, from, to, seq, version;
+} xfer_t;
+#define XFER_INTS     6
+
+//      a range of slices, and the rank it was assigned to (initially or
+//      by a recovery): this table is the same on all ranks
+typedef struct {
+   int lo, hi, owner, version;
+} range_t;
+
+static int myorig, origsize, mysize;
+static int *orig = NULL;          // original rank of each current rank
+static int *alive = NULL;         // per original rank
+
+static range_t *todo = NULL;      // my ranges not done yet
+static int ntodo = 0, mtodo = 0;
+static range_t *assigned = NULL;
+static int nassigned = 0, massigned = 0;
+static xfer_t *logs = NULL;       // ranges I gave and ranges I took
+static int nlogs = 0, mlogs = 0;
+static int gseq = 0;
+
+static int howmanydone = 0, nsteals = 0, nredone = 0, nfailures = 0;
+static double sum = 0.0;
+
+static void add_todo(int lo, int hi, int version);
+static void add_assigned(int lo, int hi, int owner, int version);
+static void add_log(int lo, int hi, int from, int to, int seq, int version);
+static int epoch(void);
+static void serve(int thief);
+static void recover(void);
+static int must_die(int idle);
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: everybody enters here, and works until the whole bag is
+ *  done; the lowest surviving rank prints the result. */
+void steal(void) {
+   int rc, r, flag, done;
+   double total, start, now;
+
+   MPI_Comm_rank(comm, &myorig);
+   MPI_Comm_size(comm, &origsize);
+   MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN);
+   mysize = origsize;
+   orig  = (int*)malloc(origsize * sizeof(int));
+   alive = (int*)malloc(origsize * sizeof(int));
+   for(r = 0; r < origsize; r++) {
+      orig[r]  = r;
+      alive[r] = 1;
+      add_assigned((long)r * nslices / origsize, (long)(r+1) * nslices / origsize, r, 0);
+   }
+   add_todo(assigned[myorig].lo, assigned[myorig].hi, 0);
+   srand(myorig + 1);
+
+   start = starttime = MPI_Wtime();
+   while(1) {
+      done = epoch();
+      if(done) {
+         //      collect the results; everybody must have them, or else
+         //      a failure happened and the lost slices are to be redone
+         rc = MPI_Allreduce(&sum, &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+         flag = (MPI_SUCCESS == rc);
+         MPIX_Comm_agree(comm, &flag);
+         if(flag) break;
+         MPIX_Comm_revoke(comm);
+      }
+      recover();
+   }
+   now = MPI_Wtime() - start;
+
+   MPI_Allreduce(MPI_IN_PLACE, &nsteals, 1, MPI_INT, MPI_SUM, comm);
+   MPI_Comm_rank(comm, &r);
+   if(0 == r) {
+      printf("STEAL: finished, result found = %g\n", total);
+      printf("STEAL: THROUGHPUT %d slices in %g s, %g slices/s (work stealing, %d ranks, %d steals, %d failures, %d slices redone)\n",
+             nslices, now, nslices / now, mysize, nsteals, nfailures, nredone);
+   }
+   free(orig); free(alive); free(todo); free(assigned); free(logs);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: with a kill schedule (-K), die when the time has come.
+ *  Otherwise, the last 'nkills' ranks die, one after the other, after a
+ *  share of their slices that grows with their distance to the end;
+ *  thieves may take that share away, so those still alive when they
+ *  are out of work (idle) die before entering the agreement. */
+static int must_die(int idle) {
+   if(0.0 <= killat && MPI_Wtime() - starttime >= killat) {
+      return 1;
+   }
+   if(killsched || myorig < origsize - nkills) {
+      return 0;
+   }
+   return idle || howmanydone >= (origsize - myorig) * (nslices / origsize) / (nkills + 1);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: work and steal until the agreement, which says if the bag
+ *  is done (1) or a failure happened (0) */
+static int epoch(void) {
+   int rc, idx, i, v, flag, ntried, thief, agreed, inagree;
+   int reply[4], aflag;
+   int *tried;
+   double width, x, y, t;
+   MPI_Request reqs[3] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+   MPI_Status status;
+
+   tried  = (int*)calloc(mysize, sizeof(int));
+   MPI_Comm_rank(comm, &i);
+   tried[i] = 1;
+   ntried = 1;
+   inagree = 0; agreed = 0; aflag = 0; v = MPI_PROC_NULL;
+   width = 1.0 / nslices;
+
+//      reqs[0]: thieves, reqs[1]: my victim, reqs[2]: the agreement
+   rc = MPI_Irecv(&thief, 1, MPI_INT, MPI_ANY_SOURCE, STEAL_TAG, comm, &reqs[0]);
+   while(MPI_SUCCESS == rc) {
+      //      work on my last range
+      if(0 < ntodo) {
+         for(i = 0; i < STEAL_POLL && 0 < ntodo; i++) {
+            t = MPI_Wtime();
+            x = width * todo[ntodo-1].lo;
+            y = 4.0 / (1.0 + x*x);
+            sum = sum + y * width;
+            while(MPI_Wtime() - t < taskusec * 1e-6);
+            if(++todo[ntodo-1].lo == todo[ntodo-1].hi) ntodo--;
+            howmanydone++;
+//---------------------Inject Abort!-------------------------
+            if(must_die(0)) {
+               printf("R%02d: CRASHING myself\n", myorig);
+               exit(-1);
+            }
+//----------------------------------------------------------
+         }
+         rc = MPI_Test(&reqs[0], &flag, &status);
+         if(MPI_SUCCESS == rc && flag) {
+            serve(status.MPI_SOURCE);
+            rc = MPI_Irecv(&thief, 1, MPI_INT, MPI_ANY_SOURCE, STEAL_TAG, comm, &reqs[0]);
+         }
+         continue;
+      }
+
+      //      out of work: pick a victim I did not try yet, or wait for
+      //      the others in the agreement
+      if(MPI_REQUEST_NULL == reqs[1] && !inagree) {
+         if(ntried == mysize) {
+//---------------------Inject Abort!-------------------------
+            if(must_die(1)) {
+               printf("R%02d: CRASHING myself, out of work\n", myorig);
+               exit(-1);
+            }
+//----------------------------------------------------------
+            aflag = 1;
+            inagree = 1;
+            rc = MPIX_Comm_iagree(comm, &aflag, &reqs[2]);
+            if(MPI_SUCCESS != rc) break;
+         }
+         else {
+            for(v = rand() % mysize; tried[v]; v = (v + 1) % mysize);
+            rc = MPI_Send(&myorig, 1, MPI_INT, v, STEAL_TAG, comm);
+            if(MPI_SUCCESS != rc) break;
+            rc = MPI_Irecv(reply, 4, MPI_INT, v, GIVE_TAG, comm, &reqs[1]);
+            if(MPI_SUCCESS != rc) break;
+         }
+      }
+
+      rc = MPI_Waitany(3, reqs, &idx, &status);
+      if(MPI_SUCCESS != rc) {
+         if(2 == idx) agreed = 1;
+         break;
+      }
+      switch(idx) {
+      case 0:
+         serve(status.MPI_SOURCE);
+         rc = MPI_Irecv(&thief, 1, MPI_INT, MPI_ANY_SOURCE, STEAL_TAG, comm, &reqs[0]);
+         break;
+      case 1:
+         if(reply[0] < reply[1]) {
+            add_todo(reply[0], reply[1], reply[3]);
+            add_log(reply[0], reply[1], orig[v], myorig, reply[2], reply[3]);
+            nsteals++;
+            memset(tried, 0, mysize * sizeof(int));
+            MPI_Comm_rank(comm, &i);
+            tried[i] = 1;
+            ntried = 1;
+         }
+         else {
+            tried[v] = 1;
+            ntried++;
+         }
+         break;
+      case 2:
+         agreed = 1;
+         break;
+      }
+      if(agreed) break;
+   }
+
+   //      a failure: make sure everybody hears about it, and take my
+   //      part in the agreement if I did not yet
+   if(!agreed) {
+      MPIX_Comm_revoke(comm);
+      if(inagree) {
+         MPI_Wait(&reqs[2], MPI_STATUS_IGNORE);
+      }
+      else {
+         aflag = 0;
+         MPIX_Comm_agree(comm, &aflag);
+      }
+      rc = MPIX_ERR_REVOKED;
+   }
+   for(i = 0; i < 2; i++) {
+      if(MPI_REQUEST_NULL != reqs[i]) {
+         MPI_Cancel(&reqs[i]);
+         MPI_Request_free(&reqs[i]);
+      }
+   }
+   free(tried);
+   return (MPI_SUCCESS == rc && 1 == aflag);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: a thief asks for work: give the top half of my first range
+ *  (the one I will work on last), or all of it if it is too small and
+ *  I have others */
+static void serve(int thief) {
+   int give[4] = { 0, 0, 0, 0 };
+
+   if(0 < ntodo) {
+      give[3] = todo[0].version + 1;
+      if(1 < todo[0].hi - todo[0].lo) {
+         give[0] = todo[0].lo + (todo[0].hi - todo[0].lo) / 2;
+         give[1] = todo[0].hi;
+         todo[0].hi = give[0];
+      }
+      else if(1 < ntodo) {
+         give[0] = todo[0].lo;
+         give[1] = todo[0].hi;
+         memmove(&todo[0], &todo[1], (ntodo-1) * sizeof(range_t));
+         ntodo--;
+      }
+   }
+   if(give[0] < give[1]) {
+      give[2] = ++gseq;
+      add_log(give[0], give[1], myorig, orig[thief], give[2], give[3]);
+   }
+   //      an error here is caught by the next operation
+   MPI_Send(give, 4, MPI_INT, thief, GIVE_TAG, comm);
+}
+
+static int cmp_xfer(const void *a, const void *b) {
+   const xfer_t *x = a, *y = b;
+   if(x->from != y->from) return x->from - y->from;
+   return x->seq - y->seq;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: after a failure. Agree on the failed group with the shrink,
+ *  and give the slices last held by the dead to the survivors. */
+static void recover(void) {
+   int rc, i, j, k, n, lo, mynew, version, flag, total = 0;
+   int *counts, *displs, *newdead, *oldranks, *newranks, *logger;
+   int *best, *holder;
+   xfer_t *all = NULL, *took;
+   MPI_Comm newcomm;
+   MPI_Group ogroup, ngroup, fgroup;
+   double start = MPI_Wtime();
+
+   newdead  = (int*)calloc(origsize, sizeof(int));
+   oldranks = (int*)malloc(origsize * sizeof(int));
+   newranks = (int*)malloc(origsize * sizeof(int));
+   counts   = (int*)malloc(origsize * sizeof(int));
+   displs   = (int*)malloc(origsize * sizeof(int));
+   do {
+      MPIX_Comm_failure_ack(comm);
+      MPIX_Comm_shrink(comm, &newcomm);
+
+//      the failed group: who is not in the new communicator
+      MPI_Comm_group(comm, &ogroup);
+      MPI_Comm_group(newcomm, &ngroup);
+      MPI_Group_difference(ogroup, ngroup, &fgroup);
+      MPI_Group_size(fgroup, &n);
+      for(i = 0; i < n; i++) newranks[i] = i;
+      MPI_Group_translate_ranks(fgroup, n, newranks, ogroup, oldranks);
+      for(i = 0; i < n; i++) {
+         newdead[orig[oldranks[i]]] = 1;
+         alive[orig[oldranks[i]]]   = 0;
+      }
+      nfailures += n;
+//      and the original ranks of the survivors
+      MPI_Group_size(ngroup, &mysize);
+      for(i = 0; i < mysize; i++) newranks[i] = i;
+      MPI_Group_translate_ranks(ngroup, mysize, newranks, ogroup, oldranks);
+      for(i = 0; i < mysize; i++) newranks[i] = orig[oldranks[i]];
+      memcpy(orig, newranks, mysize * sizeof(int));
+      MPI_Group_free(&ogroup); MPI_Group_free(&ngroup); MPI_Group_free(&fgroup);
+
+      MPI_Comm_free(&comm);
+      comm = newcomm;
+      MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN);
+      MPI_Comm_rank(comm, &mynew);
+
+//      gather the logs of all the survivors; if one more fails
+//      meanwhile, start over
+      k = nlogs * XFER_INTS;
+      rc = MPI_Allgather(&k, 1, MPI_INT, counts, 1, MPI_INT, comm);
+      if(MPI_SUCCESS == rc) {
+         for(total = 0, i = 0; i < mysize; i++) {
+            displs[i] = total;
+            total += counts[i];
+         }
+         free(all);
+         all = (xfer_t*)malloc(total * sizeof(int) + 1);
+         rc = MPI_Allgatherv(logs, k, MPI_INT, all, counts, displs, MPI_INT, comm);
+      }
+      flag = (MPI_SUCCESS == rc);
+      MPIX_Comm_agree(comm, &flag);
+      if(!flag) MPIX_Comm_revoke(comm);
+   } while(!flag);
+   total  = total / XFER_INTS;
+   logger = (int*)malloc(total * sizeof(int) + 1);
+   for(k = 0, i = 0; i < mysize; i++) {
+      for(j = 0; j < counts[i] / XFER_INTS; j++) logger[k++] = orig[i];
+   }
+   free(oldranks); free(newranks); free(counts); free(displs);
+
+//      a transfer between survivors only happened if the thief got the
+//      reply, which may have been lost with the old communicator:
+//      otherwise the range is still with the victim
+   took = (xfer_t*)malloc(total * sizeof(xfer_t) + 1);
+   for(n = 0, i = 0; i < total; i++) {
+      if(logger[i] == all[i].to) took[n++] = all[i];
+   }
+   qsort(took, n, sizeof(xfer_t), cmp_xfer);
+   for(i = 0; i < total; i++) {
+      if(logger[i] == all[i].from && alive[all[i].to]
+      && NULL == bsearch(&all[i], took, n, sizeof(xfer_t), cmp_xfer)) {
+         all[i].version = -1;
+      }
+   }
+   for(j = 0, i = 0; i < nlogs; i++) {
+      if(myorig == logs[i].from && alive[logs[i].to]
+      && NULL == bsearch(&logs[i], took, n, sizeof(xfer_t), cmp_xfer)) {
+         add_todo(logs[i].lo, logs[i].hi, logs[i].version - 1);
+         continue;
+      }
+      logs[j++] = logs[i];
+   }
+   nlogs = j;
+   free(took); free(logger);
+
+//      the last holder of each slice
+   best   = (int*)malloc(nslices * sizeof(int));
+   holder = (int*)malloc(nslices * sizeof(int));
+   for(i = 0; i < nslices; i++) best[i] = -1;
+   for(k = 0; k < nassigned; k++) {
+      for(i = assigned[k].lo; i < assigned[k].hi; i++) {
+         if(assigned[k].version > best[i]) {
+            best[i]   = assigned[k].version;
+            holder[i] = assigned[k].owner;
+         }
+      }
+   }
+   for(k = 0; k < total; k++) {
+      for(i = all[k].lo; i < all[k].hi; i++) {
+         if(all[k].version > best[i]) {
+            best[i]   = all[k].version;
+            holder[i] = all[k].to;
+         }
+      }
+   }
+   free(all);
+
+//      split those of the dead evenly between the survivors, in order;
+//      their new version supersedes all the previous ones
+   for(version = 0, total = 0, i = 0; i < nslices; i++) {
+      if(best[i] >= version) version = best[i] + 1;
+      if(newdead[holder[i]]) total++;
+   }
+   nredone += total;
+   for(n = 0, k = 0, lo = -1, i = 0; i < nslices; i++) {
+      if(!newdead[holder[i]]) {
+         if(0 <= lo) {
+            add_assigned(lo, i, orig[k], version);
+            if(k == mynew) add_todo(lo, i, version);
+            lo = -1;
+         }
+         continue;
+      }
+      while(n >= (long)(k+1) * total / mysize) {
+         if(0 <= lo) {
+            add_assigned(lo, i, orig[k], version);
+            if(k == mynew) add_todo(lo, i, version);
+            lo = -1;
+         }
+         k++;
+      }
+      if(0 > lo) lo = i;
+      n++;
+   }
+   if(0 <= lo) {
+      add_assigned(lo, nslices, orig[k], version);
+      if(k == mynew) add_todo(lo, nslices, version);
+   }
+   free(best); free(holder); free(newdead);
+
+   if(0 == mynew) {
+      printf("STEAL: recovered from %d failures in %g s, %d survivors, %d slices to redo\n",
+             nfailures, MPI_Wtime() - start, mysize, total);
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ **********************************************************************/
+static void add_todo(int lo, int hi, int version) {
+   if(ntodo == mtodo) {
+      mtodo = 2 * mtodo + 4;
+      todo  = (range_t*)realloc(todo, mtodo * sizeof(range_t));
+   }
+   todo[ntodo].lo = lo;
+   todo[ntodo].hi = hi;
+   todo[ntodo].owner = myorig;
+   todo[ntodo].version = version;
+   ntodo++;
+}
+
+static void add_assigned(int lo, int hi, int owner, int version) {
+   if(nassigned == massigned) {
+      massigned = 2 * massigned + 4;
+      assigned  = (range_t*)realloc(assigned, massigned * sizeof(range_t));
+   }
+   assigned[nassigned].lo = lo;
+   assigned[nassigned].hi = hi;
+   assigned[nassigned].owner = owner;
+   assigned[nassigned].version = version;
+   nassigned++;
+}
+
+static void add_log(int lo, int hi, int from, int to, int seq, int version) {
+   if(nlogs == mlogs) {
+      mlogs = 2 * mlogs + 4;
+      logs  = (xfer_t*)realloc(logs, mlogs * sizeof(xfer_t));
+   }
+   logs[nlogs].lo   = lo;
+   logs[nlogs].hi   = hi;
+   logs[nlogs].from = from;
+   logs[nlogs].to   = to;
+   logs[nlogs].seq  = seq;
+   logs[nlogs].version = version;
+   nlogs++;
+}
@@ -12,63 +12,103 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <math.h>
 #include <mpi.h>
 #include <mpi-ext.h>
 #include "fsolvergen.h"
 
-static int myrank, mystate;
+static int myrank, worldrank, mystate;
 static void worker_advance_state(int thisworkid);
+static double slice_usec(int workid);
 
 void worker(void) {
-   int rc, howmanydone;
-   int todo, slicestodo;
-   double result, width, x, y;
+   int rc, howmanydone, i;
+   int *todo, ntodo, slicestodo;
+   double *results, width, x, y, start, due;
+   MPI_Status status;
    MPI_Errhandler errh;
 
    mystate = AVAILABLE;
    MPI_Comm_rank(comm, &myrank);
+   MPI_Comm_rank(MPI_COMM_WORLD, &worldrank);
 
    MPI_Comm_create_errhandler(error_handler, &errh);
    MPI_Comm_set_errhandler(comm, errh);
 
 //      for the calculation I will do
-   slicestodo  = (1+maxworkers)*SLICES/MAX_SIZE;
+   slicestodo  = nslices;
    width = 1.0 / slicestodo;
 
 //      status
    howmanydone = 0;
+   todo    = (int*)malloc((maxbatch+1) * sizeof(int));
+   results = (double*)malloc((maxbatch+1) * sizeof(double));
+   todo[0] = NULLWORKID;
+   ntodo   = 0;
 
 //      all I do is get work, do a calculation and then return an answer
    while(FINISHED != mystate) {
       MPI_Comm_rank(comm, &myrank); // update myrank if it changed during the error handler
+      if(masterrank == myrank) break; // I am the new master
+      regrow_progress();
 
 //    -------------------------------------------------------
 //    get work
       if(AVAILABLE == mystate) {
-         rc = MPI_Recv(&todo, 1, MPI_INTEGER, masterrank, WORK_TAG, comm, MPI_STATUS_IGNORE);
+//       a standby applies the master updates that came first
+         rc = replica_recv(0);
+         if(MPI_SUCCESS == rc) {
+            rc = MPI_Recv(todo, maxbatch+1, MPI_INTEGER, masterrank, WORK_TAG, comm, &status);
+         }
          if(MPI_SUCCESS != rc) {
-            printf("R%02d: ERRORCODE %d while RECV WORK: [R%02d:W%04d]\n", myrank, rc, myrank, todo);
+            printf("R%02d: ERRORCODE %d while RECV WORK: [R%02d:W%04d]\n", myrank, rc, myrank, todo[0]);
+            todo[0] = NULLWORKID; // nothing was received, stay available
+         }
+         else if(GROW == todo[0]) {
+            //     new workers join us; my rank does not change
+            regrow_merge(&comm, todo[1]);
+            continue;
          }
-         worker_advance_state(todo);
+         else {
+            MPI_Get_count(&status, MPI_INTEGER, &ntodo);
+         }
+         worker_advance_state(todo[0]);
       }
 //    -------------------------------------------------------
 
 //    -------------------------------------------------------
 //    calculate
       if(RECEIVED == mystate) {
-         howmanydone = howmanydone + 1;
+         start = MPI_Wtime();
+         due   = 0.0;
+         for(i = 0; i < ntodo; i++) {
+            howmanydone = howmanydone + 1;
+
+//          calculate pi
+            x = width * todo[i];
+            y = 4.0 / (1.0 + x*x);
+            results[i] = y * width;
 
-//       calculate pi
-         x = width * todo;
-         y = 4.0 / (1.0 + x*x);
-         result = y * width;
+//          make the slice as long as requested
+            due += slice_usec(todo[i]) * 1e-6;
+            while(MPI_Wtime() - start < due);
+
+//---------------------Inject Abort!-------------------------
+            if(0.0 <= killat && !respawned && MPI_Wtime() - starttime >= killat) {
+               printf("R%02d: CRASHING myself at %g s, as scheduled\n", myrank, MPI_Wtime() - starttime);
+               exit(-1);
+            }
+//----------------------------------------------------------
+         }
+//       tell the master how long it took, it sizes the batches after it
+         results[ntodo] = MPI_Wtime() - start;
 
          worker_advance_state(NULLWORKID);
       }
 //    -------------------------------------------------------
 
 //---------------------Inject Abort!-------------------------
-      if(1 == myrank && 2 == howmanydone) {
+      if(!killsched && 1 == worldrank && !respawned && 2 <= howmanydone) {
          printf("R%02d: CRASHING myself\n", myrank);
          exit(-1);
          //MPI_Abort(MPI_COMM_SELF, -1);
@@ -78,16 +118,47 @@ void worker(void) {
 //   -------------------------------------------------------
 //       return work
       if(WORKING == mystate) {
-         rc = MPI_Send(&result, 1, MPI_DOUBLE, masterrank, RES_TAG, comm);
+         rc = MPI_Send(results, ntodo+1, MPI_DOUBLE, masterrank, RES_TAG, comm);
          if(MPI_SUCCESS != rc) {
-            printf("R%02d ERRORCODE %d while RETURN WORK: [R%02d:W%04d]\n", myrank, rc, myrank, todo);
+            printf("R%02d ERRORCODE %d while RETURN WORK: [R%02d:W%04d]\n", myrank, rc, myrank, todo[0]);
          }
          worker_advance_state(NULLWORKID);
       }
 //   -------------------------------------------------------
    }
 
-   printf("R%02d: Worker completed and I did %d operations\n", myrank, howmanydone);
+   regrow_fini();
+   if(FINISHED == mystate) {
+      replica_recv(1);
+      printf("R%02d: Worker completed and I did %d operations\n", myrank, howmanydone);
+   }
+   free(todo); free(results);
+}
+
+/*********************************************************************
+ *********************************************************************
+ *********************************************************************
+ *  Comment: how long slice workid lasts, in microseconds. The draw only
+ *  depends on the slice, so a slice done again lasts as long. The heavy
+ *  tailed distribution is a Pareto of shape PARETO_SHAPE (infinite
+ *  variance); both random ones have a mean of taskusec. */
+static double slice_usec(int workid) {
+   unsigned long long x;
+   double u;
+
+   if(DIST_CONST == taskdist) {
+      return taskusec;
+   }
+   //     splitmix64 of the slice number, to a uniform draw in (0, 1]
+   x = (unsigned long long)workid + 0x9E3779B97F4A7C15ULL;
+   x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+   x = x ^ (x >> 31);
+   u = ((x >> 11) + 1.0) / 9007199254740992.0;
+   if(DIST_EXP == taskdist) {
+      return -taskusec * log(u);
+   }
+   return taskusec * (PARETO_SHAPE - 1.0) / PARETO_SHAPE / pow(u, 1.0 / PARETO_SHAPE);
 }
 
 /*********************************************************************
@@ -15,6 +15,7 @@
  */     
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <mpi.h>
 #include <mpi-ext.h>
 #include "fsolvergen.h"
@@ -24,9 +25,9 @@ void error_handler(MPI_Comm *pcomm, int *error_code, ...) {
    int rc, i, myrank, oldrank, num_fails, error_class;
    char error_string[MPI_MAX_ERROR_STRING];
    MPI_Group f_group, w_group;
-   int f_group_rank[MAX_SIZE], w_group_rank[MAX_SIZE];
+   int *f_group_rank, *w_group_rank;
    MPI_Comm communicator = *pcomm, new_comm;
-   int mapsto[MAX_SIZE];
+   int *mapsto = NULL;
 
 
    // Who I was on the original communicator (for debugging purposes)
@@ -48,11 +49,14 @@ void error_handler(MPI_Comm *pcomm, int *error_code, ...) {
          ...
          //     Get no. of failed procs
          ...
+         f_group_rank = (int*)malloc(num_fails * sizeof(int));
+         w_group_rank = (int*)malloc(num_fails * sizeof(int));
          //     Get ranks of failed procs in the original comm
          ...
          //     And mark them dead
          for(i = 0; i < num_fails; i++) 
             mark_dead(w_group_rank[i]);
+         free(f_group_rank); free(w_group_rank);
          //     Stop the workers
          ...
       }
@@ -68,14 +72,15 @@ void error_handler(MPI_Comm *pcomm, int *error_code, ...) {
       maxworkers = maxworkers - 1; // do not double count the master
       //     Tell the storage, to map from old to new communicator:
       //     Gather: old process ranks at location new process
+      mapsto = (int*)malloc((maxworkers+1) * sizeof(int));
       MPI_Gather(&oldrank, 1, MPI_INT,
                  mapsto,  1, MPI_INT,
                  0, communicator);
       for(i = 1; i <= maxworkers; i++) {
          printf("MASTER: worker R%02d is now R%02d\n", mapsto[i], i);
-         state[i]       = state[mapsto[i]];
-         currentwork[i] = currentwork[mapsto[i]];
+         remap_worker(i, mapsto[i]);
       }
+      free(mapsto);
       break;
    
    case MPI_ERR_REVOKED:
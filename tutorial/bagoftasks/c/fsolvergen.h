@@ -19,9 +19,8 @@
 //  contents of message the indicates no more work (i.e. FINISHed)
 #define FINISH				(-999)
 
-//  sizes 
-#define MAX_SIZE			128
-#define SLICES				(MAX_SIZE * 5)
+//  default number of slices per process
+#define SLICES_PER_PROC		5
 
 //  worker state 
 #define AVAILABLE			0
@@ -47,15 +46,13 @@
 #define WINPROGRESS			1
 #define WDONE				2
 
-//  work structure
-extern int wworkid[SLICES];
-extern int wrank[SLICES];
-extern int wworkstate[SLICES];
+//  work structure (nslices entries)
+extern int *wrank;
+extern int *wworkstate;
 
-//  proc structure
-extern int rank[MAX_SIZE];
-extern int currentwork[MAX_SIZE];
-extern int state[MAX_SIZE];
+//  proc structure (maxworkers+1 entries)
+extern int *rank;
+extern int *state;
 
 
 //  Some constants
@@ -66,6 +63,20 @@ extern int state[MAX_SIZE];
 extern int maxworkers;
 extern int masterrank;
 
+//  Number of slices in the bag
+extern int nslices;
+
+//  Batching: at most maxbatch slices per message, and up to prefetch
+//  messages in flight per worker; with adaptive, the batch size follows
+//  the measured slice duration and round trip time (up to maxbatch)
+extern int maxbatch;
+extern int prefetch;
+extern int adaptive;
+
+//  Synthetic slice duration in microseconds (busy wait), and less output
+extern double taskusec;
+extern int quiet;
+
 //  The main communicator
 extern MPI_Comm comm;
 
@@ -78,3 +89,4 @@ void error_handler(MPI_Comm *comm, int *error_code, ...);
 
 void mark_error(int r);
 void mark_dead(int r);
+void remap_worker(int newr, int oldr);
@@ -35,15 +35,44 @@
 #include <mpi.h>
 #include <mpi-ext.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
 #include "fsolvergen.h"
 
 /* some globals */
 int maxworkers = 0;
 int masterrank = 0;
+int nslices = 0;
+int maxbatch = 1;
+int prefetch = 1;
+int adaptive = 0;
+double taskusec = 0.0;
+int quiet = 0;
 MPI_Comm comm = MPI_COMM_NULL;
 
+static void usage(char *name) {
+  printf("Usage: %s [options] [nslices]\n"
+         "  -b, --batch <n>       at most n slices per work message (default 1)\n"
+         "  -k, --prefetch <n>    up to n work messages in flight per worker (default 1)\n"
+         "  -a, --adaptive        size batches from the measured slice and round trip\n"
+         "                        times, up to --batch slices\n"
+         "  -t, --taskusec <us>   make each slice last us microseconds (default 0)\n"
+         "  -q, --quiet           do not report every slice sent and done\n"
+         "  -h, --help            this message\n", name);
+}
+
 int main(int argc, char *argv[]) {
   int myrank = MPI_PROC_NULL, size = 0, rc = MPI_SUCCESS;
+  int c;
+  struct option long_options[] = {
+    { "batch",    required_argument, 0, 'b' },
+    { "prefetch", required_argument, 0, 'k' },
+    { "adaptive", no_argument,       0, 'a' },
+    { "taskusec", required_argument, 0, 't' },
+    { "quiet",    no_argument,       0, 'q' },
+    { "help",     no_argument,       0, 'h' },
+    { 0, 0, 0, 0 }
+  };
 
   MPI_Init(&argc, &argv);
   MPI_Comm_rank(MPI_COMM_WORLD, &myrank);
@@ -55,12 +84,36 @@ int main(int argc, char *argv[]) {
   MPI_Comm_dup(MPI_COMM_WORLD, &comm);
 
   maxworkers = size-1;
-  if(masterrank == myrank) {
-    if(size > MAX_SIZE) {
-      printf("This program can use a maximum %d processes.", MAX_SIZE);
-      MPI_Abort(MPI_COMM_WORLD, 1);
+  while(1) {
+    c = getopt_long(argc, argv, "b:k:at:qh", long_options, NULL);
+    if(-1 == c) break;
+    switch(c) {
+    case 'b': maxbatch = atoi(optarg); break;
+    case 'k': prefetch = atoi(optarg); break;
+    case 'a': adaptive = 1; break;
+    case 't': taskusec = atof(optarg); break;
+    case 'q': quiet = 1; break;
+    case 'h':
+    default:
+      if(masterrank == myrank) usage(argv[0]);
+      MPI_Finalize();
+      return 0;
     }
-    printf("MASTER: I am R%02d and I will manage %d workers\n", myrank, maxworkers);
+  }
+  /* The number of slices can be given on the command line */
+  nslices = size * SLICES_PER_PROC;
+  if(argc > optind) {
+    nslices = atoi(argv[optind]);
+  }
+  if(0 >= nslices || 0 >= maxbatch || 0 >= prefetch || 0.0 > taskusec) {
+    if(masterrank == myrank) printf("Invalid parameters: %d slices, batch %d, prefetch %d, %g us per slice\n",
+                                    nslices, maxbatch, prefetch, taskusec);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  if(masterrank == myrank) {
+    printf("MASTER: I am R%02d and I will manage %d workers for %d slices\n", myrank, maxworkers, nslices);
+    printf("MASTER: batches of %s%d slices, %d batches in flight per worker\n",
+           adaptive? "up to ": "", maxbatch, prefetch);
     master();
   }
   else {
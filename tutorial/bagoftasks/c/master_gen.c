@@ -15,48 +15,89 @@
  *  the master code */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <mpi.h>
 #include "fsolvergen.h"
 
-int wworkid[SLICES];
-int wrank[SLICES];
-int wworkstate[SLICES];
+int *wrank = NULL;
+int *wworkstate = NULL;
 static void init_work(int slicestodo);
 
-int rank[MAX_SIZE];
-int currentwork[MAX_SIZE];
-int state[MAX_SIZE];
+//      the bag of slices that are not done: a ring buffer used as a
+//      double ended queue. A slice is in the bag at most once, so
+//      nslices entries are enough.
+static int *wqueue = NULL;
+static int wqhead  = 0;
+static int wqcount = 0;
+static void putwork_back(int workid);
+static void putwork_front(int workid);
+
+int *rank = NULL;
+int *state = NULL;
 static void init_states(int max);
+static int nfinished = 0;
+
+//      batches in flight, per worker: a ring of 'prefetch' batches of at
+//      most 'maxbatch' slices each, oldest first. Workers process their
+//      batches in order, so results come back in the same order.
+static int *bids      = NULL;    // slices of each batch
+static int *blen      = NULL;    // number of slices in each batch
+static double *bsent  = NULL;    // date the batch was sent
+static double *bbusy  = NULL;    // worker compute time known when sent
+static int *bhead     = NULL;    // oldest batch, per worker
+static int *binflight = NULL;    // number of batches in flight, per worker
+static double *wbusy  = NULL;    // compute time reported, per worker
+#define BATCH(r, b)  ((r)*prefetch + ((bhead[r] + (b)) % prefetch))
+static void putbatch_front(int r, int b);
+
+//      adaptive batch size: running estimates of the time to compute
+//      one slice, and of the round trip master-worker-master
+static double esttask = 0.0;
+static double estrtt  = 0.0;
+static int nsamples   = 0;
+#define EST_WEIGHT   0.25   // weight of a new sample in the estimates
+#define BATCH_COVER  2.0    // queued work, in round trips
+#define BATCH_ALONE  8.0    // batch length without prefetch, in round trips
+static int batchsize(void);
+
+//      workers that asked for work while the bag was empty
+static int *idle = NULL;
+static int nidle = 0;
 
 int getnextwork(void);
 void advance_state(int r, int workid);
+static void dispatch(int r, int slicestodo);
+static void post_result(int r, double *results, MPI_Request *req);
+static void reset_pending(MPI_Request *reqs, int n);
 
 
 
 void master(void) {
-   int rc, i, thisproc;
+   int rc, i, thisproc, b, n;
    MPI_Errhandler errh;
 
 //      result stuff
-   double result, deltaresult;
+   double result, *results, *res, rtt, now;
    int slicestodo;
+   double start;
 
-//      work distribution
-   int next;
-
-//      recovery
-   int isfinished;
+//      pending result receptions, one per worker (for its oldest
+//      batch), indexed by rank
+   MPI_Request *reqs;
+   MPI_Comm reqcomm;
 
 //      startup
-   isfinished  = 0;
-   slicestodo  = (1+maxworkers)*SLICES/MAX_SIZE;
+   slicestodo  = nslices;
    result      = 0.0;
-   deltaresult = 0.0;
-   next        = 0;
 
 //      init worker states
    init_states(maxworkers);
    init_work(slicestodo);
+   results = (double*)malloc((maxworkers+1) * (maxbatch+1) * sizeof(double));
+   reqs = (MPI_Request*)malloc((maxworkers+1) * sizeof(MPI_Request));
+   for(i = 0; i <= maxworkers; i++) {
+      reqs[i] = MPI_REQUEST_NULL;
+   }
 
 /********************************************************************/
 // WE NEED TO PREVENT THE MASTER FROM ABORTING WHEN A WORKER FAILS
@@ -65,55 +106,244 @@ void master(void) {
 //
 /********************************************************************/
 
-
 //      loop until we have done all the work or lost all my workers
-//      The loop contains of two parts: distribute work, and
-//      collect the results. In case a worker dies, his work is
-//      marked as 'not done' and redistributed.
-   while(0 != slicestodo && isfinished < maxworkers) {
-
-      //      distribute work
-      for(thisproc = 1; thisproc <= maxworkers; thisproc++) {
-         if(AVAILABLE == state[thisproc]) {
-            next = getnextwork();
-            rc = MPI_Send(&next, 1, MPI_INTEGER, thisproc, WORK_TAG, comm);
-            if(MPI_SUCCESS != rc) {
-               printf("MASTER: ERRORCODE %d while sending to R%02d\n", rc, thisproc);
-               continue;
-            }
-            advance_state(thisproc, next);
+//      The loop is event driven: every available worker is given up
+//      to 'prefetch' batches of slices and a receive is posted for the
+//      result of its oldest batch; then we wait for any result to come
+//      back and immediately give more work to that worker, so a slow
+//      worker does not hold the others, and a worker always has its
+//      next batch at hand when it finishes the current one.
+//      In case a worker dies, all its batches are put back in front
+//      of the bag and redistributed.
+   start = MPI_Wtime();
+   reqcomm = MPI_COMM_NULL;
+   while(0 != slicestodo && nfinished < maxworkers) {
+
+      //      first round, or the error handler replaced the
+      //      communicator (shrink): receptions posted on the old one
+      //      will never match, start over with everybody
+      if(reqcomm != comm) {
+         reset_pending(reqs, maxworkers+1);
+         reqcomm = comm;
+         for(thisproc = 1; thisproc <= maxworkers && reqcomm == comm; thisproc++) {
+            dispatch(thisproc, slicestodo);
+            post_result(thisproc, results, &reqs[thisproc]);
          }
+         continue;
       }
 
-      //      get results
-      isfinished = 0;
-      for(thisproc = 1; thisproc <= maxworkers; thisproc++) {
-         if(WORKING == state[thisproc]) {
-            rc = MPI_Recv(&deltaresult, 1, MPI_DOUBLE,
-                          thisproc, RES_TAG, comm, MPI_STATUS_IGNORE);
-            if(MPI_SUCCESS != rc) {
-               printf("MASTER: ERRORCODE %d while receiving from R%02d\n", rc, thisproc);
-               continue;
-         }
-            advance_state(thisproc, NULLWORKID);
-         }
+      //      slices of dead workers are back in the bag: wake up the
+      //      workers that had nothing to do
+      while(0 < nidle && 0 < wqcount && reqcomm == comm) {
+         thisproc = idle[--nidle];
+         dispatch(thisproc, slicestodo);
+         post_result(thisproc, results, &reqs[thisproc]);
+      }
 
-         if(RECEIVED == state[thisproc]) {
-            result = result + deltaresult;
-            slicestodo = slicestodo - 1;
-            advance_state(thisproc, NULLWORKID);
+      //      get the next result, whoever it comes from
+      rc = MPI_Waitany(maxworkers+1, reqs, &thisproc, MPI_STATUS_IGNORE);
+      if(MPI_SUCCESS != rc) {
+         printf("MASTER: ERRORCODE %d while receiving from R%02d\n", rc, thisproc);
+         continue;
+      }
+      if(MPI_UNDEFINED == thisproc) continue;
+
+      advance_state(thisproc, NULLWORKID);
+      if(RECEIVED == state[thisproc]) {
+         //      the oldest batch of this worker is done
+         b   = BATCH(thisproc, 0);
+         n   = blen[b];
+         res = &results[thisproc * (maxbatch+1)];
+         for(i = 0; i < n; i++) {
+            result = result + res[i];
+            wworkstate[bids[b*maxbatch+i]] = WDONE;
+         }
+         slicestodo = slicestodo - n;
+
+         //      update the estimates: the worker reports the time it
+         //      spent computing the batch; the rest of the time since
+         //      the batch was sent, once the batches that were ahead of
+         //      it are accounted for, is the round trip
+         wbusy[thisproc] += res[n];
+         rtt = (MPI_Wtime() - bsent[b]) - (wbusy[thisproc] - bbusy[b]);
+         if(rtt < 0.0) rtt = 0.0;
+         if(0 == nsamples++) {
+            esttask = res[n] / n;
+            estrtt  = rtt;
          }
-         else if(FINISHED == state[thisproc]
-              || DEAD     == state[thisproc]) {
-            isfinished = isfinished + 1;
+         else {
+            esttask = (1.0-EST_WEIGHT) * esttask + EST_WEIGHT * res[n] / n;
+            estrtt  = (1.0-EST_WEIGHT) * estrtt  + EST_WEIGHT * rtt;
          }
+
+         bhead[thisproc] = (bhead[thisproc] + 1) % prefetch;
+         binflight[thisproc]--;
+         advance_state(thisproc, bids[b*maxbatch]);
+         dispatch(thisproc, slicestodo);
+         post_result(thisproc, results, &reqs[thisproc]);
       }
    }
 
+   //      release the workers left waiting for work
+   while(0 < nidle) {
+      thisproc = idle[--nidle];
+      dispatch(thisproc, slicestodo);
+   }
+
    if(0 < slicestodo) {
       printf("MASTER: There are %d slices left to calculate\n", slicestodo);
    }
    printf("MASTER: finished, result found = %g\n", result);
+   now = MPI_Wtime() - start;
+   printf("MASTER: THROUGHPUT %d slices in %g s, %g slices/s (batch %d%s, prefetch %d, est. slice %g s, est. round trip %g s)\n",
+          nslices - slicestodo, now, (nslices - slicestodo) / now,
+          maxbatch, adaptive? " adaptive": "", prefetch, esttask, estrtt);
+
+   free(results); free(reqs);
+   free(wrank); free(wworkstate); free(wqueue);
+   free(rank); free(state); free(idle);
+   free(bids); free(blen); free(bsent); free(bbusy);
+   free(bhead); free(binflight); free(wbusy);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: sends batches of slices to worker r until it has prefetch
+ *  batches in flight. When all slices are given out but some are still
+ *  in progress, a worker with nothing to do is left idle: a failure
+ *  may put work back in the bag that it can take over. */
+static void dispatch(int r, int slicestodo) {
+   int rc, i, b, n, *ids;
+   MPI_Comm sendcomm = comm;
+
+   while((AVAILABLE == state[r] || WORKING == state[r])
+      && binflight[r] < prefetch) {
+      b   = BATCH(r, binflight[r]);
+      ids = &bids[b*maxbatch];
+      n   = batchsize();
+      for(i = 0; i < n && 0 < wqcount; i++) {
+         ids[i] = getnextwork();
+      }
+      if(0 == i) {
+         if(AVAILABLE == state[r] && 0 < slicestodo) {
+            idle[nidle++] = r;
+            return;
+         }
+         if(WORKING == state[r]) {
+            return;
+         }
+         ids[0] = FINISH;
+         i = 1;
+      }
+      n = i;
+      rc = MPI_Send(ids, n, MPI_INTEGER, r, WORK_TAG, sendcomm);
+      if(MPI_SUCCESS != rc) {
+         printf("MASTER: ERRORCODE %d while sending to R%02d\n", rc, r);
+         if(FINISH != ids[0]) {
+            for(i = n-1; i >= 0; i--) putwork_front(ids[i]);
+         }
+         return;
+      }
+      advance_state(r, ids[0]);
+      if(FINISHED == state[r]) {
+         return;
+      }
+      for(i = 0; i < n; i++) {
+         wworkstate[ids[i]] = WINPROGRESS;
+         wrank[ids[i]]      = r;
+      }
+      blen[b]  = n;
+      bsent[b] = MPI_Wtime();
+      bbusy[b] = wbusy[r];
+      binflight[r]++;
+   }
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: posts the reception of the result of the oldest batch of
+ *  worker r: one value per slice, followed by the time spent computing
+ *  them. */
+static void post_result(int r, double *results, MPI_Request *req) {
+   if(WORKING != state[r] || MPI_REQUEST_NULL != *req) {
+      return;
+   }
+   MPI_Irecv(&results[r * (maxbatch+1)], blen[BATCH(r, 0)]+1, MPI_DOUBLE,
+             r, RES_TAG, comm, req);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: the number of slices to put in the next batch. With a fixed
+ *  batch size, this is maxbatch. Otherwise, the prefetch-1 batches
+ *  queued behind the one being computed must cover BATCH_COVER round
+ *  trips, so that a worker never waits for work; without prefetch, the
+ *  batch must be long enough to make the round trip negligible. As the
+ *  bag empties, batches get smaller so that the last slices are spread
+ *  over all workers. */
+static int batchsize(void) {
+   double n;
+   int nalive, share;
+
+   if(!adaptive) {
+      return maxbatch;
+   }
+   if(0 == nsamples) {
+      return 1;
+   }
+   if(0.0 == esttask) {
+      return maxbatch;
+   }
+   if(1 < prefetch) {
+      n = BATCH_COVER * estrtt / (esttask * (prefetch-1));
+   }
+   else {
+      n = BATCH_ALONE * estrtt / esttask;
+   }
+   nalive = maxworkers - nfinished;
+   if(0 < nalive) {
+      share = (wqcount + nalive*prefetch - 1) / (nalive*prefetch);
+      if(n > share) n = share;
+   }
+   if(n < 1.0) return 1;
+   if(n > maxbatch) return maxbatch;
+   return (int)(n + 0.999);
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: after a shrink, ranks have been renumbered and the results
+ *  in flight on the old communicator are lost. Drop the pending
+ *  receptions, and put the slices they were waiting for back in the
+ *  bag so that the (renumbered) workers can be given new work. */
+static void reset_pending(MPI_Request *reqs, int n) {
+   int i, b;
+
+   for(i = 0; i < n; i++) {
+      if(MPI_REQUEST_NULL != reqs[i]) {
+         MPI_Cancel(&reqs[i]);
+         MPI_Request_free(&reqs[i]);
+      }
+   }
+   nfinished = 0;
+   nidle     = 0;
+   for(i = 1; i <= maxworkers; i++) {
+      if(WORKING == state[i]) {
+         for(b = binflight[i]-1; b >= 0; b--) {
+            putbatch_front(i, b);
+         }
+         binflight[i] = 0;
+         state[i]     = AVAILABLE;
+      }
+      else if(FINISHED == state[i]
+           || DEAD     == state[i]) {
+         nfinished = nfinished + 1;
+      }
+   }
 }
 
 /***********************************************************************
@@ -121,12 +351,28 @@ void master(void) {
  **********************************************************************/
 void init_states(int max) {
    int i;
+
+   rank      = (int*)malloc((max+1) * sizeof(int));
+   state     = (int*)malloc((max+1) * sizeof(int));
+   idle      = (int*)malloc((max+1) * sizeof(int));
+   bhead     = (int*)malloc((max+1) * sizeof(int));
+   binflight = (int*)malloc((max+1) * sizeof(int));
+   wbusy     = (double*)malloc((max+1) * sizeof(double));
+   bids      = (int*)malloc((max+1) * prefetch * maxbatch * sizeof(int));
+   blen      = (int*)malloc((max+1) * prefetch * sizeof(int));
+   bsent     = (double*)malloc((max+1) * prefetch * sizeof(double));
+   bbusy     = (double*)malloc((max+1) * prefetch * sizeof(double));
+   nidle     = 0;
+   nfinished = 0;
 //      note: 0 is me.. and I don't work
-   for(i = 1; i <= max; i++) {
-      rank[i]        = i;
-      currentwork[i] = -1;
-      state[i]       = AVAILABLE;
+   for(i = 0; i <= max; i++) {
+      rank[i]      = i;
+      state[i]     = AVAILABLE;
+      bhead[i]     = 0;
+      binflight[i] = 0;
+      wbusy[i]     = 0.0;
    }
+   state[0] = INVALID;
 }
 
 /***********************************************************************
@@ -134,60 +380,58 @@ void init_states(int max) {
  **********************************************************************/
 void init_work(int slicestodo) {
    int i;
-//      note: slice is from 0 to SLICES-1
-   for(i = 0; i < SLICES; i++) {
-      wworkid[i]    = i;
-      wrank[i]      = MPI_PROC_NULL;
-      wworkstate[i] = WNOTDONE;
-      if(i > slicestodo) 
-         wworkstate[i] = WDONE;
+
+   wrank      = (int*)malloc(slicestodo * sizeof(int));
+   wworkstate = (int*)malloc(slicestodo * sizeof(int));
+   wqueue     = (int*)malloc(slicestodo * sizeof(int));
+   wqhead     = 0;
+   wqcount    = 0;
+//      note: slice is from 0 to slicestodo-1
+   for(i = 0; i < slicestodo; i++) {
+      putwork_back(i);
    }
 }
 
 /***********************************************************************
  ***********************************************************************
  ***********************************************************************
- *  Comment: the second argument workid is just used in a single case */
+ *  Comment: the second argument workid is the first slice of the batch
+ *  that was sent or completed (NULLWORKID when a result arrives) */
 void advance_state(int r, int workid) {
-   int tmp, rc;
-
    switch(state[r]) {
-   
+
    case AVAILABLE:
       if(NULLWORKID == workid) {
-         printf("MASTER: Invalid workid [R02d:W%04d]\n", r, workid);
+         printf("MASTER: Invalid workid [R%02d:W%04d]\n", r, workid);
          MPI_Abort(MPI_COMM_WORLD, 1);
       }
       else if(FINISH == workid) {
          state[r]       = FINISHED;
-         currentwork[r] = SLICES; // i.e. empty tag
+         nfinished      = nfinished + 1;
          printf("MASTER: FINISHED: worker R%02d\n", r);
+         break;
       }
-      else {
-         state[r]       = WORKING;
-         currentwork[r] = workid;
-      }
+      state[r] = WORKING;
+      /* fallthrough */
 
-      printf("MASTER: SENT WORK: [R%02d:W%04d]\n", r, workid); 
-      //      mark work as 'in progress'
-      wworkstate[workid] = WINPROGRESS;
-      wrank[workid]      = r;
-      break;
-   
    case WORKING:
-      state[r] = RECEIVED;
+      if(NULLWORKID == workid) {
+         state[r] = RECEIVED;
+      }
+      else if(!quiet) {
+         printf("MASTER: SENT WORK: [R%02d:W%04d]\n", r, workid);
+      }
       break;
 
    case RECEIVED:
-      //      mark work as finished */
-      tmp = currentwork[r];
-      wworkstate[tmp]  = WDONE;
-      state[r]         = AVAILABLE;
-      currentwork[r]   = SLICES; // i.e. empty tag
-      printf("MASTER: DONE WORK: [R%02d:W%04d]\n", r, tmp);
+      //      the batch is finished, are there others in flight?
+      state[r] = (0 < binflight[r])? WORKING: AVAILABLE;
+      if(!quiet) {
+         printf("MASTER: DONE WORK: [R%02d:W%04d]\n", r, workid);
+      }
       break;
-    
-   case SEND_FAILED:            
+
+   case SEND_FAILED:
       state[r] = AVAILABLE;
       break;
 
@@ -226,27 +470,90 @@ void mark_error(int r) {
  ***********************************************************************
  **********************************************************************/
 void mark_dead(int r) {
-   int tmp;
+   int b;
 
+   //      the same failure may be reported more than once
+   if(DEAD == state[r]) {
+      return;
+   }
+   //      put all its batches back in front of the bag, so that they
+   //      are redistributed first, in the same order
+   if(WORKING == state[r]) {
+      for(b = binflight[r]-1; b >= 0; b--) {
+         putbatch_front(r, b);
+      }
+      binflight[r] = 0;
+   }
+   if(FINISHED != state[r]) {
+      nfinished = nfinished + 1;
+   }
    state[r] = DEAD;
-   //      mark its current work as not yet done again
-   tmp             = currentwork[r];
-   wworkstate[tmp] = WNOTDONE;
-   wrank[tmp]      = MPI_PROC_NULL;
+}
+
+/***********************************************************************
+ ***********************************************************************
+ ***********************************************************************
+ *  Comment: after a shrink, the worker that was oldr is now newr
+ *  (newr <= oldr, so the tables can be moved in increasing order) */
+void remap_worker(int newr, int oldr) {
+   int b, i, from, to;
+
+   if(newr == oldr) {
+      return;
+   }
+   for(b = 0; b < binflight[oldr]; b++) {
+      from = BATCH(oldr, b);
+      to   = newr*prefetch + b;
+      for(i = 0; i < blen[from]; i++) {
+         bids[to*maxbatch+i] = bids[from*maxbatch+i];
+      }
+      blen[to]  = blen[from];
+      bsent[to] = bsent[from];
+      bbusy[to] = bbusy[from];
+   }
+   state[newr]     = state[oldr];
+   bhead[newr]     = 0;
+   binflight[newr] = binflight[oldr];
+   wbusy[newr]     = wbusy[oldr];
 }
 
 /***********************************************************************
  ***********************************************************************
  **********************************************************************/
 int getnextwork(void) {
-   int i, next = FINISH;
+   int next = FINISH;
 
-   for(i = 0; i < SLICES; i++) {
-      if(WNOTDONE == wworkstate[i]) {
-         next = wworkid[i];
-         break;
-      }
+   if(0 < wqcount) {
+      next   = wqueue[wqhead];
+      wqhead = (wqhead + 1) % nslices;
+      wqcount--;
    }
-   //printf("State %d ID %d\n", wworkstate[i], wworkid[i]);
    return next;
 }
+
+/***********************************************************************
+ ***********************************************************************
+ **********************************************************************/
+static void putwork_back(int workid) {
+   wqueue[(wqhead + wqcount) % nslices] = workid;
+   wqcount++;
+   wworkstate[workid] = WNOTDONE;
+   wrank[workid]      = MPI_PROC_NULL;
+}
+
+static void putwork_front(int workid) {
+   wqhead = (wqhead + nslices - 1) % nslices;
+   wqueue[wqhead] = workid;
+   wqcount++;
+   wworkstate[workid] = WNOTDONE;
+   wrank[workid]      = MPI_PROC_NULL;
+}
+
+static void putbatch_front(int r, int b) {
+   int i;
+
+   b = BATCH(r, b);
+   for(i = blen[b]-1; i >= 0; i--) {
+      putwork_front(bids[b*maxbatch+i]);
+   }
+}
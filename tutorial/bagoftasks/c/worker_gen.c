@@ -16,17 +16,19 @@
 #include <mpi-ext.h>
 #include "fsolvergen.h"
 
-static int myrank, mystate;
+static int myrank, worldrank, mystate;
 static void worker_advance_state(int thisworkid);
 
 void worker(void) {
-   int rc, howmanydone;
-   int todo, slicestodo;
-   double result, width, x, y;
+   int rc, howmanydone, i;
+   int *todo, ntodo, slicestodo;
+   double *results, width, x, y, start;
+   MPI_Status status;
    MPI_Errhandler errh;
 
    mystate = AVAILABLE;
    MPI_Comm_rank(comm, &myrank);
+   MPI_Comm_rank(MPI_COMM_WORLD, &worldrank);
 
 /********************************************************************/
 // IN BLANK MODE, THIS PROGRAM NEEDS NOTHING ON THE WORKER SIDE
@@ -39,11 +41,15 @@ void worker(void) {
 /********************************************************************/
 
 //      for the calculation I will do
-   slicestodo  = (1+maxworkers)*SLICES/MAX_SIZE;
+   slicestodo  = nslices;
    width = 1.0 / slicestodo;
 
 //      status
    howmanydone = 0;
+   todo    = (int*)malloc(maxbatch * sizeof(int));
+   results = (double*)malloc((maxbatch+1) * sizeof(double));
+   todo[0] = NULLWORKID;
+   ntodo   = 0;
 
 //      all I do is get work, do a calculation and then return an answer
    while(FINISHED != mystate) {
@@ -52,30 +58,42 @@ void worker(void) {
 //    -------------------------------------------------------
 //    get work
       if(AVAILABLE == mystate) {
-         rc = MPI_Recv(&todo, 1, MPI_INTEGER, masterrank, WORK_TAG, comm, MPI_STATUS_IGNORE);
+         rc = MPI_Recv(todo, maxbatch, MPI_INTEGER, masterrank, WORK_TAG, comm, &status);
          if(MPI_SUCCESS != rc) {
-            printf("R%02d: ERRORCODE %d while RECV WORK: [R%02d:W%04d]\n", myrank, rc, myrank, todo);
+            printf("R%02d: ERRORCODE %d while RECV WORK: [R%02d:W%04d]\n", myrank, rc, myrank, todo[0]);
+            todo[0] = NULLWORKID; // nothing was received, stay available
          }
-         worker_advance_state(todo);
+         else {
+            MPI_Get_count(&status, MPI_INTEGER, &ntodo);
+         }
+         worker_advance_state(todo[0]);
       }
 //    -------------------------------------------------------
 
 //    -------------------------------------------------------
 //    calculate
       if(RECEIVED == mystate) {
-         howmanydone = howmanydone + 1;
+         start = MPI_Wtime();
+         for(i = 0; i < ntodo; i++) {
+            howmanydone = howmanydone + 1;
+
+//          calculate pi
+            x = width * todo[i];
+            y = 4.0 / (1.0 + x*x);
+            results[i] = y * width;
 
-//       calculate pi
-         x = width * todo;
-         y = 4.0 / (1.0 + x*x);
-         result = y * width;
+//          make the slice as long as requested
+            while(MPI_Wtime() - start < (i+1) * taskusec * 1e-6);
+         }
+//       tell the master how long it took, it sizes the batches after it
+         results[ntodo] = MPI_Wtime() - start;
 
          worker_advance_state(NULLWORKID);
       }
 //    -------------------------------------------------------
 
 //---------------------Inject Abort!-------------------------
-      if(1 == myrank && 2 == howmanydone) {
+      if(1 == worldrank && 2 <= howmanydone) {
          printf("R%02d: CRASHING myself\n", myrank);
          exit(-1);
          //MPI_Abort(MPI_COMM_SELF, -1);
@@ -85,9 +103,9 @@ void worker(void) {
 //   -------------------------------------------------------
 //       return work
       if(WORKING == mystate) {
-         rc = MPI_Send(&result, 1, MPI_DOUBLE, masterrank, RES_TAG, comm);
+         rc = MPI_Send(results, ntodo+1, MPI_DOUBLE, masterrank, RES_TAG, comm);
          if(MPI_SUCCESS != rc) {
-            printf("R%02d ERRORCODE %d while RETURN WORK: [R%02d:W%04d]\n", myrank, rc, myrank, todo);
+            printf("R%02d ERRORCODE %d while RETURN WORK: [R%02d:W%04d]\n", myrank, rc, myrank, todo[0]);
          }
          worker_advance_state(NULLWORKID);
       }
@@ -95,6 +113,7 @@ void worker(void) {
    }
 
    printf("R%02d: Worker completed and I did %d operations\n", myrank, howmanydone);
+   free(todo); free(results);
 }
 
 /*********************************************************************
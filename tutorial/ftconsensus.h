@@ -0,0 +1,205 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013-2020 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Consensus on small values, on top of MPIX_Comm_agree, that all the
+ * surviving processes decide alike even when processes fail meanwhile
+ * (or the communicator is revoked):
+ *  - ftc_agree_min / ftc_agree_max: of an int;
+ *  - ftc_agree_union: of sets, as bitmaps of 'nwords' unsigned ints;
+ *  - ftc_elect: the lowest ranked alive candidate.
+ * MPIX_Comm_agree only ANDs an int. The min is decided 5 bits at a time,
+ * from the top: each process still matching the digits decided so far
+ * sets the bits 1..d of its flag, d being its next digit, and the AND
+ * keeps the bits 1..min(d). The others set all the bits; those that
+ * match clear bit 0, so that the agreement tells if one of them took
+ * part: if all of them died, the digits decided so far are the prefix
+ * of no survivor, and it starts over. That is 7 agreements for an int,
+ * plus 7 per restart. When no
+ * process fails, a cheaper MPI_Allreduce, validated by one agreement,
+ * gives the same result (ftc_set_reduce(0) disables it).
+ * These functions are collective, return MPI_SUCCESS or the first error
+ * seen, and do not call the error handler of comm (failures are
+ * acknowledged).
+ */
+
+#ifndef FTCONSENSUS_H
+#define FTCONSENSUS_H
+
+#include <mpi.h>
+#include <mpi-ext.h>
+#include <stdlib.h>
+#include <limits.h>
+
+static int ftc_reduce = 1;
+
+/* use (1) or not (0) the reduction fast path */
+static inline void ftc_set_reduce(int reduce)
+{
+    ftc_reduce = reduce;
+}
+
+/* one agreement, done again until it does not report new failures */
+static inline int ftc_agree(MPI_Comm comm, int* flag)
+{
+    int rc, eclass, f;
+
+    do {
+        f = *flag;
+        rc = MPIX_Comm_agree(comm, &f);
+        MPI_Error_class(rc, &eclass);
+        if( MPIX_ERR_PROC_FAILED != eclass ) break;
+        MPIX_Comm_failure_ack(comm);
+    } while(1);
+    *flag = f;
+    return rc;
+}
+
+/* the min of unsigned keys, digit by digit */
+static inline int ftc_agree_digits(MPI_Comm comm, unsigned* key)
+{
+    unsigned prefix = 0, mask = 0, dmask;
+    int shift, width, d, flag, rc, ret = MPI_SUCCESS;
+
+    for( shift = 30; shift >= 0; shift -= 5 ) {
+        width = (30 == shift)? 2: 5;
+        dmask = ((1u << width) - 1) << shift;
+        if( (*key & mask) == prefix ) {
+            d = (*key & dmask) >> shift;
+            flag = (int)(((2u << d) - 1) & ~1u); /* bits 1..d */
+        }
+        else {
+            flag = ~0;
+        }
+        rc = ftc_agree(comm, &flag);
+        if( MPI_SUCCESS != rc && MPI_SUCCESS == ret ) ret = rc;
+        if( flag & 1 ) {
+            /* nobody left with this prefix: again, among the survivors */
+            prefix = mask = 0;
+            shift = 35;
+            continue;
+        }
+        for( d = 0; d < 31 && ((unsigned)flag >> (d+1)) & 1u; d++ );
+        prefix |= (unsigned)d << shift;
+        mask |= dmask;
+    }
+    *key = prefix;
+    return ret;
+}
+
+/* the reduction fast path: returns 1 if it worked everywhere */
+static inline int ftc_try_reduce(MPI_Comm comm, void* in, void* out, int count,
+                                 MPI_Datatype type, MPI_Op op)
+{
+    int flag;
+
+    if( !ftc_reduce ) return 0;
+    flag = (MPI_SUCCESS == MPI_Allreduce(in, out, count, type, op, comm));
+    ftc_agree(comm, &flag);
+    return flag;
+}
+
+static inline int ftc_agree_min(MPI_Comm comm, int* value)
+{
+    MPI_Errhandler errh;
+    unsigned key;
+    int result, rc = MPI_SUCCESS;
+
+    MPI_Comm_get_errhandler(comm, &errh);
+    MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN);
+    if( ftc_try_reduce(comm, value, &result, 1, MPI_INT, MPI_MIN) ) {
+        *value = result;
+    }
+    else {
+        key = (unsigned)*value ^ 0x80000000u; /* same order as the ints */
+        rc = ftc_agree_digits(comm, &key);
+        *value = (int)(key ^ 0x80000000u);
+    }
+    MPI_Comm_set_errhandler(comm, errh);
+    MPI_Errhandler_free(&errh);
+    return rc;
+}
+
+static inline int ftc_agree_max(MPI_Comm comm, int* value)
+{
+    int rc, v = ~*value; /* reverses the order */
+
+    rc = ftc_agree_min(comm, &v);
+    *value = ~v;
+    return rc;
+}
+
+/* the union of the sets of all the processes */
+static inline int ftc_agree_union(MPI_Comm comm, unsigned* set, int nwords)
+{
+    MPI_Errhandler errh;
+    unsigned* result;
+    int i, flag, rc, ret = MPI_SUCCESS;
+
+    MPI_Comm_get_errhandler(comm, &errh);
+    MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN);
+    result = (unsigned*)malloc(nwords * sizeof(unsigned));
+    if( ftc_try_reduce(comm, set, result, nwords, MPI_UNSIGNED, MPI_BOR) ) {
+        for( i = 0; i < nwords; i++ ) set[i] = result[i];
+    }
+    else {
+        for( i = 0; i < nwords; i++ ) {
+            flag = (int)~set[i];
+            rc = ftc_agree(comm, &flag);
+            if( MPI_SUCCESS != rc && MPI_SUCCESS == ret ) ret = rc;
+            set[i] = ~(unsigned)flag;
+        }
+    }
+    free(result);
+    MPI_Comm_set_errhandler(comm, errh);
+    MPI_Errhandler_free(&errh);
+    return ret;
+}
+
+/* the leader is the lowest ranked candidate that no process knows
+ * failed; MPI_PROC_NULL if there is none */
+static inline int ftc_elect(MPI_Comm comm, int candidate, int* leader)
+{
+    MPI_Errhandler errh;
+    MPI_Group group, fgroup;
+    int rank, v, lowest = 0, flag, rc, ret = MPI_SUCCESS;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_group(comm, &group);
+    MPI_Comm_get_errhandler(comm, &errh);
+    MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN);
+    do {
+        v = (candidate && rank >= lowest)? rank: INT_MAX;
+        rc = ftc_agree_min(comm, &v);
+        if( MPI_SUCCESS != rc && MPI_SUCCESS == ret ) ret = rc;
+        if( INT_MAX == v ) {
+            v = MPI_PROC_NULL;
+            break;
+        }
+        /* a candidate that failed after its contribution */
+        MPIX_Comm_failure_ack(comm);
+        MPIX_Comm_failure_get_acked(comm, &fgroup);
+        MPI_Group_translate_ranks(group, 1, &v, fgroup, &flag);
+        if( MPI_GROUP_EMPTY != fgroup ) MPI_Group_free(&fgroup);
+        flag = (MPI_UNDEFINED == flag);
+        rc = ftc_agree(comm, &flag);
+        if( MPI_SUCCESS != rc && MPI_SUCCESS == ret ) ret = rc;
+        lowest = v + 1;
+    } while( !flag );
+    MPI_Comm_set_errhandler(comm, errh);
+    MPI_Errhandler_free(&errh);
+    MPI_Group_free(&group);
+    *leader = v;
+    return ret;
+}
+
+#endif  /* FTCONSENSUS_H */
@@ -0,0 +1,220 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * The failed processes of a communicator, with MPIX_Comm_get_failed /
+ * MPIX_Comm_ack_failed when the library has them, and with the legacy
+ * MPIX_Comm_failure_ack / MPIX_Comm_failure_get_acked otherwise. The
+ * choice is made at build time: FTF_GET_FAILED is 1 for the former, set
+ * from OMPI_HAVE_MPIX_COMM_GET_FAILED unless it is given (-DFTF_GET_FAILED=0
+ * forces the legacy calls).
+ *  - ftf_ack_failed: acknowledges the failures known so far, and returns
+ *    them as a group;
+ *  - ftf_get_failed: the failures known so far, without acknowledging
+ *    them (the acknowledged ones only with the legacy calls);
+ *  - ftf_is_revoked: MPIX_Comm_is_revoked, or a probe that sees the
+ *    revocation with the legacy calls;
+ *  - ftf_translate: the ranks in comm of the n processes of a group,
+ *    without allocating on each call (error handlers do it on the
+ *    critical path of the recovery);
+ *  - ftf_cache_update / ftf_is_failed: the same, incrementally, for
+ *    handlers called many times during a failure storm (see below).
+ * The groups returned are MPI_GROUP_EMPTY or have to be freed with
+ * ftf_group_free.
+ */
+
+#ifndef FTFAILED_H
+#define FTFAILED_H
+
+#include <mpi.h>
+#include <mpi-ext.h>
+#include <stdlib.h>
+
+#ifndef FTF_GET_FAILED
+#if defined(OMPI_HAVE_MPIX_COMM_GET_FAILED) && OMPI_HAVE_MPIX_COMM_GET_FAILED
+#define FTF_GET_FAILED 1
+#else
+#define FTF_GET_FAILED 0
+#endif
+#endif  /* FTF_GET_FAILED */
+
+#if FTF_GET_FAILED
+#define FTF_API_NAME "MPIX_Comm_get_failed"
+#else
+#define FTF_API_NAME "MPIX_Comm_failure_get_acked"
+#endif
+
+static int* ftf_seq = NULL;
+static int ftf_nseq = 0;
+
+static inline int ftf_ack_failed(MPI_Comm comm, MPI_Group* failed)
+{
+#if FTF_GET_FAILED
+    int rc, nf, nacked;
+
+    rc = MPIX_Comm_get_failed(comm, failed);
+    if( MPI_SUCCESS != rc ) return rc;
+    /* the group only grows, in order: these are the first nf */
+    MPI_Group_size(*failed, &nf);
+    return MPIX_Comm_ack_failed(comm, nf, &nacked);
+#else
+    int rc;
+
+    rc = MPIX_Comm_failure_ack(comm);
+    if( MPI_SUCCESS != rc ) return rc;
+    return MPIX_Comm_failure_get_acked(comm, failed);
+#endif
+}
+
+static inline int ftf_get_failed(MPI_Comm comm, MPI_Group* failed)
+{
+#if FTF_GET_FAILED
+    return MPIX_Comm_get_failed(comm, failed);
+#else
+    return MPIX_Comm_failure_get_acked(comm, failed);
+#endif
+}
+
+static inline int ftf_is_revoked(MPI_Comm comm, int* flag)
+{
+#if FTF_GET_FAILED
+    return MPIX_Comm_is_revoked(comm, flag);
+#else
+    MPI_Errhandler errh;
+    int rc, eclass, probed;
+
+    MPI_Comm_get_errhandler(comm, &errh);
+    MPI_Comm_set_errhandler(comm, MPI_ERRORS_RETURN);
+    rc = MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &probed, MPI_STATUS_IGNORE);
+    MPI_Comm_set_errhandler(comm, errh);
+    MPI_Errhandler_free(&errh);
+    MPI_Error_class(rc, &eclass);
+    *flag = (MPIX_ERR_REVOKED == eclass);
+    return MPI_SUCCESS;
+#endif
+}
+
+/* 0, 1... n-1 */
+static inline int* ftf_seq_get(int n)
+{
+    int i;
+
+    if( n > ftf_nseq ) {
+        ftf_seq = (int*)realloc(ftf_seq, n * sizeof(int));
+        for( i = ftf_nseq; i < n; i++ ) ftf_seq[i] = i;
+        ftf_nseq = n;
+    }
+    return ftf_seq;
+}
+
+static inline int ftf_translate(MPI_Comm comm, MPI_Group failed, int n, int* ranks)
+{
+    MPI_Group group;
+    int rc;
+
+    MPI_Comm_group(comm, &group);
+    rc = MPI_Group_translate_ranks(failed, n, ftf_seq_get(n), group, ranks);
+    MPI_Group_free(&group);
+    return rc;
+}
+
+static inline void ftf_group_free(MPI_Group* failed)
+{
+    if( MPI_GROUP_EMPTY != *failed ) MPI_Group_free(failed);
+    *failed = MPI_GROUP_NULL;
+}
+
+/*
+ * The failures of a communicator, cached in an attribute of it and
+ * updated with the difference between successive acknowledged groups
+ * (they only grow, in order): ftf_cache_update acknowledges, translates
+ * the new failures only, and returns how many there are; they are
+ * ranks[nf - nnew .. nf-1]. ftf_is_failed looks up the bitmap. The
+ * cache is freed with the communicator, and not copied by a dup.
+ */
+typedef struct {
+    int        size;   /* of the group of the communicator */
+    int        nf;     /* failures known */
+    int        nnew;   /* of which new at the last update */
+    int        max;    /* room in ranks */
+    int*       ranks;  /* in the communicator, in order (MPI_UNDEFINED
+                        * if not in its group) */
+    unsigned*  bitmap;
+    MPI_Group  group;
+} ftf_cache_t;
+
+static int ftf_keyval = MPI_KEYVAL_INVALID;
+
+static int ftf_cache_delete(MPI_Comm comm, int keyval, void* attr, void* extra)
+{
+    ftf_cache_t* cache = (ftf_cache_t*)attr;
+
+    MPI_Group_free(&cache->group);
+    free(cache->ranks);
+    free(cache->bitmap);
+    free(cache);
+    return MPI_SUCCESS;
+}
+
+static inline ftf_cache_t* ftf_cache_get(MPI_Comm comm)
+{
+    ftf_cache_t* cache;
+    int flag;
+
+    if( MPI_KEYVAL_INVALID == ftf_keyval )
+        MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, ftf_cache_delete,
+                               &ftf_keyval, NULL);
+    MPI_Comm_get_attr(comm, ftf_keyval, &cache, &flag);
+    if( flag ) return cache;
+
+    cache = (ftf_cache_t*)calloc(1, sizeof(ftf_cache_t));
+    MPI_Comm_group(comm, &cache->group);
+    MPI_Group_size(cache->group, &cache->size);
+    cache->bitmap = (unsigned*)calloc((cache->size + 31) / 32, sizeof(unsigned));
+    MPI_Comm_set_attr(comm, ftf_keyval, cache);
+    return cache;
+}
+
+static inline int ftf_cache_update(MPI_Comm comm, ftf_cache_t** pcache)
+{
+    ftf_cache_t* cache = ftf_cache_get(comm);
+    MPI_Group failed;
+    int i, n, r;
+
+    *pcache = cache;
+    cache->nnew = 0;
+    ftf_ack_failed(comm, &failed);
+    MPI_Group_size(failed, &n);
+    if( n > cache->nf ) {
+        if( n > cache->max ) {
+            cache->max = (2 * cache->max > n)? 2 * cache->max: n;
+            cache->ranks = (int*)realloc(cache->ranks, cache->max * sizeof(int));
+        }
+        MPI_Group_translate_ranks(failed, n - cache->nf, ftf_seq_get(n) + cache->nf,
+                                  cache->group, cache->ranks + cache->nf);
+        for( i = cache->nf; i < n; i++ ) {
+            r = cache->ranks[i];
+            if( MPI_UNDEFINED != r ) cache->bitmap[r / 32] |= 1u << (r % 32);
+        }
+        cache->nnew = n - cache->nf;
+        cache->nf = n;
+    }
+    ftf_group_free(&failed);
+    return cache->nnew;
+}
+
+static inline int ftf_is_failed(ftf_cache_t* cache, int rank)
+{
+    return (cache->bitmap[rank / 32] >> (rank % 32)) & 1u;
+}
+
+#endif  /* FTFAILED_H */
@@ -0,0 +1,252 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013-2021 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * Replacement of the dead processes of a communicator, once the
+ * survivors have shrunk it, by new processes that take the ranks of the
+ * dead ones (as in 11.respawn_reorder.c). Two ways to get the new
+ * processes:
+ *  - ftr_spawn: the survivors spawn them with MPI_Comm_spawn;
+ *  - ftr_accept: they are started by somebody else (a launcher, a
+ *    resource manager, or they were waiting as spares) and connect to
+ *    the survivors. The survivors open a port and publish it under
+ *    'service': when the name has a '/', it is a file, where the port
+ *    name is written; otherwise it goes through MPI_Publish_name. They
+ *    come as one or several jobs, each job connects with its
+ *    MPI_COMM_WORLD, and is merged with the survivors and the jobs
+ *    before it, until all the dead are replaced. The extra processes, if
+ *    any, get MPI_COMM_NULL.
+ * The new processes call ftr_join, which finds out how they were started.
+ * 'epoch' is a value of the survivors given to the new processes (where
+ * to resume, for instance). No failure is expected during the recovery:
+ * the caller checks the result with MPIX_Comm_agree on the new
+ * communicator and starts over if needed (see 11.respawn_reorder.c).
+ */
+
+#ifndef FTREPLACE_H
+#define FTREPLACE_H
+
+#include <mpi.h>
+#include <mpi-ext.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+/* what a new process receives: its rank (-1 if not needed), how many
+ * have joined with it, how many are expected, and the epoch */
+#define FTR_NINFO 4
+
+/* the ranks in comm of the processes not in scomm */
+static inline int* ftr_dead(MPI_Comm comm, MPI_Comm scomm, int* nd)
+{
+    MPI_Group cgrp, sgrp, dgrp;
+    int i, *dead;
+
+    MPI_Comm_group(comm, &cgrp);
+    MPI_Comm_group(scomm, &sgrp);
+    MPI_Group_difference(cgrp, sgrp, &dgrp);
+    MPI_Group_size(dgrp, nd);
+    dead = (int*)malloc((*nd + 1) * sizeof(int));
+    for( i = 0; i < *nd; i++ )
+        MPI_Group_translate_ranks(dgrp, 1, &i, cgrp, &dead[i]);
+    MPI_Group_free(&cgrp); MPI_Group_free(&sgrp);
+    if( MPI_GROUP_EMPTY != dgrp ) MPI_Group_free(&dgrp);
+    return dead;
+}
+
+/* everybody takes its former rank, the new processes that of the dead
+ * process they replace */
+static inline int ftr_split(MPI_Comm* mcomm, int crank, MPI_Comm* newcomm)
+{
+    int rc;
+
+    rc = MPI_Comm_split(*mcomm, (crank < 0)? MPI_UNDEFINED: 0, crank, newcomm);
+    MPI_Comm_free(mcomm);
+    return rc;
+}
+
+static inline int ftr_publish(const char* service, const char* port)
+{
+    char tmp[PATH_MAX];
+    FILE* f;
+
+    if( NULL == strchr(service, '/') )
+        return MPI_Publish_name(service, MPI_INFO_NULL, port);
+    /* written aside, then renamed: the readers never see half of it */
+    snprintf(tmp, sizeof(tmp), "%s.tmp", service);
+    if( NULL == (f = fopen(tmp, "w")) ) return MPI_ERR_OTHER;
+    fprintf(f, "%s\n", port);
+    fclose(f);
+    return rename(tmp, service)? MPI_ERR_OTHER: MPI_SUCCESS;
+}
+
+static inline void ftr_unpublish(const char* service, const char* port)
+{
+    if( NULL == strchr(service, '/') )
+        MPI_Unpublish_name(service, MPI_INFO_NULL, port);
+    else
+        unlink(service);
+}
+
+/* waits until the survivors publish their port */
+static inline int ftr_lookup(const char* service, char* port)
+{
+    MPI_Errhandler errh;
+    FILE* f;
+    int rc;
+
+    if( NULL != strchr(service, '/') ) {
+        do {
+            if( NULL != (f = fopen(service, "r")) ) {
+                rc = (NULL != fgets(port, MPI_MAX_PORT_NAME, f));
+                fclose(f);
+                if( rc ) break;
+            }
+            usleep(1000);
+        } while(1);
+        port[strcspn(port, "\n")] = '\0';
+        return MPI_SUCCESS;
+    }
+    /* the errors of MPI_Lookup_name go to MPI_COMM_WORLD */
+    MPI_Comm_get_errhandler(MPI_COMM_WORLD, &errh);
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+    while( MPI_SUCCESS != (rc = MPI_Lookup_name(service, MPI_INFO_NULL, port)) )
+        usleep(1000);
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, errh);
+    MPI_Errhandler_free(&errh);
+    return rc;
+}
+
+/* The members of *cur accept the jobs of new processes and merge with
+ * them, until nd have joined. Rank 0 of *cur (a survivor, the merges
+ * keep them first) has the dead ranks and gives them out. */
+static inline int ftr_accept_all(const char* port, MPI_Comm* cur, int joined, int nd,
+                                 int* dead, int epoch)
+{
+    MPI_Comm icomm, mcomm;
+    int rank, r, j, v[FTR_NINFO], rc;
+
+    while( joined < nd ) {
+        rc = MPI_Comm_accept(port, MPI_INFO_NULL, 0, *cur, &icomm);
+        if( MPI_SUCCESS != rc ) return rc;
+        MPI_Comm_rank(*cur, &rank);
+        MPI_Comm_remote_size(icomm, &r);
+        if( 0 == rank ) {
+            for( j = 0; j < r; j++ ) {
+                v[0] = (joined + j < nd)? dead[joined + j]: -1;
+                v[1] = joined + r;
+                v[2] = nd;
+                v[3] = epoch;
+                MPI_Send(v, FTR_NINFO, MPI_INT, j, 1, icomm);
+            }
+        }
+        joined += r;
+        rc = MPI_Intercomm_merge(icomm, 0, &mcomm);
+        MPI_Comm_free(&icomm);
+        if( MPI_SUCCESS != rc ) return rc;
+        MPI_Comm_free(cur);
+        *cur = mcomm;
+    }
+    return MPI_SUCCESS;
+}
+
+static inline int ftr_spawn(MPI_Comm comm, MPI_Comm scomm, char* command, char** argv,
+                            int* epoch, MPI_Comm* newcomm)
+{
+    MPI_Comm icomm, mcomm;
+    int nc, ns, nd, crank, srank, j, v[FTR_NINFO], rc, *dead;
+
+    MPI_Comm_size(comm, &nc);
+    MPI_Comm_size(scomm, &ns);
+    MPI_Comm_rank(comm, &crank);
+    MPI_Comm_rank(scomm, &srank);
+    rc = MPI_Comm_spawn(command, argv, nc - ns, MPI_INFO_NULL, 0, scomm, &icomm, MPI_ERRCODES_IGNORE);
+    if( MPI_SUCCESS != rc ) return rc;
+    if( 0 == srank ) {
+        dead = ftr_dead(comm, scomm, &nd);
+        for( j = 0; j < nd; j++ ) {
+            v[0] = dead[j]; v[1] = v[2] = nd; v[3] = *epoch;
+            MPI_Send(v, FTR_NINFO, MPI_INT, j, 1, icomm);
+        }
+        free(dead);
+    }
+    rc = MPI_Intercomm_merge(icomm, 0, &mcomm);
+    MPI_Comm_free(&icomm);
+    if( MPI_SUCCESS != rc ) return rc;
+    return ftr_split(&mcomm, crank, newcomm);
+}
+
+static inline int ftr_accept(MPI_Comm comm, MPI_Comm scomm, const char* service,
+                             int* epoch, MPI_Comm* newcomm)
+{
+    char port[MPI_MAX_PORT_NAME] = "";
+    MPI_Comm cur;
+    int nc, ns, nd, crank, srank, rc, *dead = NULL;
+
+    MPI_Comm_size(comm, &nc);
+    MPI_Comm_size(scomm, &ns);
+    MPI_Comm_rank(comm, &crank);
+    MPI_Comm_rank(scomm, &srank);
+    if( 0 == srank ) {
+        dead = ftr_dead(comm, scomm, &nd);
+        MPI_Open_port(MPI_INFO_NULL, port);
+        ftr_publish(service, port);
+    }
+    MPI_Comm_dup(scomm, &cur);
+    rc = ftr_accept_all(port, &cur, 0, nc - ns, dead, *epoch);
+    if( 0 == srank ) {
+        ftr_unpublish(service, port);
+        MPI_Close_port(port);
+        free(dead);
+    }
+    if( MPI_SUCCESS != rc ) {
+        MPI_Comm_free(&cur);
+        return rc;
+    }
+    return ftr_split(&cur, crank, newcomm);
+}
+
+/* for a new process, started by ftr_spawn or to connect to ftr_accept
+ * (the service is not used when spawned) */
+static inline int ftr_join(const char* service, int* epoch, MPI_Comm* newcomm)
+{
+    char port[MPI_MAX_PORT_NAME] = "";
+    MPI_Comm parent, icomm, cur;
+    int v[FTR_NINFO], rc;
+
+    MPI_Comm_get_parent(&parent);
+    if( MPI_COMM_NULL != parent ) {
+        MPI_Recv(v, FTR_NINFO, MPI_INT, 0, 1, parent, MPI_STATUS_IGNORE);
+        rc = MPI_Intercomm_merge(parent, 1, &cur);
+        MPI_Comm_free(&parent);
+    }
+    else {
+        ftr_lookup(service, port);
+        rc = MPI_Comm_connect(port, MPI_INFO_NULL, 0, MPI_COMM_WORLD, &icomm);
+        if( MPI_SUCCESS != rc ) return rc;
+        MPI_Recv(v, FTR_NINFO, MPI_INT, 0, 1, icomm, MPI_STATUS_IGNORE);
+        rc = MPI_Intercomm_merge(icomm, 1, &cur);
+        MPI_Comm_free(&icomm);
+        if( MPI_SUCCESS == rc ) {
+            /* the next jobs, if this one was not enough */
+            port[0] = '\0';
+            rc = ftr_accept_all(port, &cur, v[1], v[2], NULL, v[3]);
+        }
+    }
+    if( MPI_SUCCESS != rc ) return rc;
+    *epoch = v[3];
+    return ftr_split(&cur, v[0], newcomm);
+}
+
+#endif  /* FTREPLACE_H */
@@ -20,6 +20,7 @@
 #include <signal.h>
 #include <setjmp.h>
 #include "header.h"
+#include "../ftconsensus.h"
 
 static int MPIX_Comm_replace(MPI_Comm comm, MPI_Comm *newcomm);
 
@@ -40,8 +41,10 @@ static jmp_buf stack_jmp_buf;
  * error injection */
 static int app_reload_ckpt(MPI_Comm comm)
 {
-    /* Fall back to the last checkpoint */
-    MPI_Allreduce(&ckpt_iteration, &iteration, 1, MPI_INT, MPI_MIN, comm);
+    /* Fall back to the last checkpoint: all decide the same iteration,
+     * even if processes fail meanwhile */
+    iteration = ckpt_iteration;
+    ftc_agree_min(comm, &iteration);
     iteration++;
     return 0;
 }
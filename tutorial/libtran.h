@@ -0,0 +1,362 @@
+/* -*- Mode: C; c-basic-offset:4 ; indent-tabs-mode:nil -*- */
+/*
+ * Copyright (c) 2013-2017 The University of Tennessee and The University
+ *                         of Tennessee Research Foundation.  All rights
+ *                         reserved.
+ * $COPYRIGHT$
+ *
+ * Additional copyrights may follow
+ *
+ * $HEADER$
+ */
+
+/*
+ * A small transaction library: TRY_BLOCK / CATCH_BLOCK / END_BLOCK, on
+ * top of MPIX_Comm_agree. An exception raised in a block (RAISE, for
+ * instance from an error handler) revokes the communicator and jumps to
+ * the end of the block; the block commits when all the processes agree
+ * that none of them raised an exception, otherwise all of them run the
+ * catch part.
+ *
+ * Group commit: with libtran_set_commit(group, window), consecutive
+ * blocks of the same nesting level share one agreement, every 'group'
+ * blocks; with a window, up to 'window' of these agreements are in
+ * flight (MPIX_Comm_iagree) while the next blocks run speculatively.
+ * A block that ends before its agreement is known commits
+ * speculatively; if the agreement then reports an exception, the
+ * execution rolls back to the oldest uncommitted block, and runs its
+ * catch part. libtran_undone() tells how many blocks after it were
+ * undone. Hence:
+ *  - the blocks of a group must be in the same function call (a loop,
+ *    typically), and re-executable: only the control flow is rolled
+ *    back (variables must be volatile to be used after the rollback);
+ *  - call libtran_flush() before leaving that function, to complete
+ *    the pending agreements (it may roll back as well);
+ *  - a process that raises an exception carries on to the end of the
+ *    group, so that all processes agree the same number of times.
+ * Pending blocks nested in a block are committed when it ends; if they
+ * fail, the exception goes to the enclosing block.
+ *
+ * The default, libtran_set_commit(1, 0), agrees at the end of every
+ * block. The nesting depth is not limited.
+ */
+
+#ifndef LIBTRAN_H
+#define LIBTRAN_H
+
+#include <mpi.h>
+#include <mpi-ext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+
+#define LIBTRAN_ACTIVE    0
+#define LIBTRAN_ROLLBACK  1
+
+typedef struct libtran_block_s {
+    jmp_buf jmp;
+    MPI_Comm comm;
+    int level;
+    int state;
+    int exception;  /* agreed, for a block rolled back to */
+} libtran_block_t;
+
+typedef struct libtran_agree_s {
+    int nblocks;    /* the blocks it commits */
+    int flag;
+    MPI_Request req;
+} libtran_agree_t;
+
+typedef struct libtran_level_s {
+    libtran_block_t** blocks;  /* not committed yet, oldest first */
+    int nblocks, maxblocks;
+    libtran_agree_t** agrees;  /* in flight, oldest first (the flags
+                                * must not move) */
+    int nagrees, maxagrees;
+    int open;                  /* blocks of the group being filled */
+    int flag;
+    MPI_Comm comm;
+} libtran_level_t;
+
+static libtran_block_t** __libtran_active = NULL; /* the blocks we are in */
+static int __libtran_depth = 0, __libtran_maxdepth = 0;
+static libtran_level_t* __libtran_levels = NULL;
+static int __libtran_nlevels = 0;
+static int __libtran_in_agree = 0;
+static int __libtran_group = 1, __libtran_window = 0;
+static int __libtran_undone = 0;
+
+#define TRY_BLOCK(COMM, EXCEPTION) \
+  do { \
+    int* __exception = &(EXCEPTION); \
+    EXCEPTION = setjmp(*libtran_push(COMM)); \
+    if( 0 == EXCEPTION ) {
+
+#define CATCH_BLOCK(COMM)  \
+    } \
+  if( 0 != libtran_commit(*__exception) ) {
+
+#define END_BLOCK() \
+  } } while (0);
+
+#define RAISE(COMM, EXCEPTION) \
+  libtran_raise((COMM), (EXCEPTION)) /* escape from hell */
+
+static inline int libtran_init(void)
+{
+    __libtran_depth = 0;
+    __libtran_group = 1;
+    __libtran_window = 0;
+    return 0;
+}
+
+/* blocks of a level share an agreement every 'group' blocks, and up to
+ * 'window' agreements are in flight (0: blocking agreement) */
+static inline void libtran_set_commit(int group, int window)
+{
+    __libtran_group = (1 > group)? 1: group;
+    __libtran_window = (0 > window)? 0: window;
+}
+
+/* the number of blocks undone by the last rollback */
+static inline int libtran_undone(void)
+{
+    return __libtran_undone;
+}
+
+static inline libtran_level_t* libtran_level(int level)
+{
+    int i;
+
+    if( level >= __libtran_nlevels ) {
+        __libtran_levels = (libtran_level_t*)realloc(__libtran_levels,
+                                                     (level+1) * sizeof(libtran_level_t));
+        for( i = __libtran_nlevels; i <= level; i++ ) {
+            __libtran_levels[i].blocks = NULL;
+            __libtran_levels[i].nblocks = __libtran_levels[i].maxblocks = 0;
+            __libtran_levels[i].agrees = NULL;
+            __libtran_levels[i].nagrees = __libtran_levels[i].maxagrees = 0;
+            __libtran_levels[i].open = 0;
+            __libtran_levels[i].flag = ~0;
+            __libtran_levels[i].comm = MPI_COMM_NULL;
+        }
+        __libtran_nlevels = level+1;
+    }
+    return &__libtran_levels[level];
+}
+
+/* entering a block: its context is saved in the returned jmp_buf */
+static inline jmp_buf* libtran_push(MPI_Comm comm)
+{
+    libtran_block_t* b = (libtran_block_t*)malloc(sizeof(libtran_block_t));
+
+    if( __libtran_depth == __libtran_maxdepth ) {
+        __libtran_maxdepth = 2 * __libtran_maxdepth + 4;
+        __libtran_active = (libtran_block_t**)realloc(__libtran_active,
+                                                      __libtran_maxdepth * sizeof(libtran_block_t*));
+    }
+    b->comm = comm;
+    b->level = __libtran_depth;
+    b->state = LIBTRAN_ACTIVE;
+    b->exception = 0;
+    __libtran_active[__libtran_depth++] = b;
+    return &b->jmp;
+}
+
+/* the agreement of the group being filled starts (or is done, without
+ * a window) */
+static inline void libtran_close(libtran_level_t* l)
+{
+    libtran_agree_t* a;
+
+    if( 0 == l->open ) return;
+    if( l->nagrees == l->maxagrees ) {
+        l->maxagrees = 2 * l->maxagrees + 4;
+        l->agrees = (libtran_agree_t**)realloc(l->agrees, l->maxagrees * sizeof(libtran_agree_t*));
+    }
+    a = (libtran_agree_t*)malloc(sizeof(libtran_agree_t));
+    l->agrees[l->nagrees++] = a;
+    a->nblocks = l->open;
+    a->flag = l->flag;
+    a->req = MPI_REQUEST_NULL;
+    __libtran_in_agree = 1;
+    if( 0 == __libtran_window ) {
+        MPIX_Comm_agree(l->comm, &a->flag);
+    }
+    else {
+        MPIX_Comm_iagree(l->comm, &a->flag, &a->req);
+    }
+    __libtran_in_agree = 0;
+    l->open = 0;
+    l->flag = ~0;
+}
+
+/* drop all the blocks and agreements of a level, after a failed
+ * agreement; the first block is kept if keep */
+static inline void libtran_drop(libtran_level_t* l, int keep)
+{
+    int i;
+
+    __libtran_in_agree = 1;
+    for( i = 0; i < l->nagrees; i++ ) {
+        MPI_Wait(&l->agrees[i]->req, MPI_STATUS_IGNORE);
+        free(l->agrees[i]);
+    }
+    __libtran_in_agree = 0;
+    for( i = keep; i < l->nblocks; i++ ) {
+        free(l->blocks[i]);
+    }
+    __libtran_undone = l->nblocks - 1;
+    l->nblocks = l->nagrees = l->open = 0;
+    l->flag = ~0;
+}
+
+/* complete the oldest agreement in flight: commit its blocks, or
+ * return the exception (the blocks are still there) */
+static inline int libtran_complete(libtran_level_t* l)
+{
+    libtran_agree_t* a = l->agrees[0];
+    int i, n;
+
+    __libtran_in_agree = 1;
+    MPI_Wait(&a->req, MPI_STATUS_IGNORE);
+    __libtran_in_agree = 0;
+    if( ~0 != a->flag ) {
+        return ~a->flag;
+    }
+    n = a->nblocks;
+    free(a);
+    for( i = 0; i < n; i++ ) {
+        free(l->blocks[i]);
+    }
+    l->nblocks -= n;
+    for( i = 0; i < l->nblocks; i++ ) {
+        l->blocks[i] = l->blocks[i + n];
+    }
+    l->nagrees--;
+    for( i = 0; i < l->nagrees; i++ ) {
+        l->agrees[i] = l->agrees[i+1];
+    }
+    return 0;
+}
+
+/* a failed agreement: go back to the oldest uncommitted block, unless
+ * it is 'current' (the block ending now), then return the exception */
+static inline int libtran_rollback(libtran_level_t* l, libtran_block_t* current, int exception)
+{
+    libtran_block_t* first = l->blocks[0];
+
+    libtran_drop(l, 1);
+    if( first == current ) {
+        free(first);
+        return exception;
+    }
+    first->state = LIBTRAN_ROLLBACK;
+    first->exception = exception;
+    __libtran_active[__libtran_depth++] = first;
+    longjmp(first->jmp, exception);
+    return exception; /* not reached */
+}
+
+/* commit everything pending at a level, without rolling back: returns
+ * the exception if an agreement failed */
+static inline int libtran_flush_level(int level)
+{
+    libtran_level_t* l;
+    int exception = 0;
+
+    if( level >= __libtran_nlevels ) return 0;
+    l = &__libtran_levels[level];
+    libtran_close(l);
+    while( 0 < l->nagrees && 0 == exception ) {
+        exception = libtran_complete(l);
+    }
+    if( 0 != exception ) {
+        libtran_drop(l, 0);
+    }
+    return exception;
+}
+
+/* end of the body of the current block (or an exception escaped from
+ * it): returns the agreed exception, 0 when the block committed (maybe
+ * speculatively) */
+static inline int libtran_commit(int exception)
+{
+    libtran_block_t* b = __libtran_active[--__libtran_depth];
+    libtran_level_t* l;
+    int rc;
+
+    if( LIBTRAN_ROLLBACK == b->state ) {
+        /* we came back here: the agreement is known */
+        exception = b->exception;
+        free(b);
+        return exception;
+    }
+    /* the blocks nested in this one are done */
+    exception |= libtran_flush_level(b->level + 1);
+
+    l = libtran_level(b->level);
+    if( 0 < l->open && l->comm != b->comm ) {
+        libtran_close(l);
+    }
+    if( l->nblocks == l->maxblocks ) {
+        l->maxblocks = 2 * l->maxblocks + 4;
+        l->blocks = (libtran_block_t**)realloc(l->blocks, l->maxblocks * sizeof(libtran_block_t*));
+    }
+    l->blocks[l->nblocks++] = b;
+    l->comm = b->comm;
+    l->flag &= ~exception;
+    if( ++l->open == __libtran_group ) {
+        libtran_close(l);
+    }
+    while( l->nagrees > __libtran_window ) {
+        rc = libtran_complete(l);
+        if( 0 != rc ) return libtran_rollback(l, b, rc);
+    }
+    return 0;
+}
+
+/* complete the pending agreements of the current level; on failure,
+ * roll back to the oldest uncommitted block */
+static inline void libtran_flush(void)
+{
+    libtran_level_t* l;
+    int rc;
+
+    if( __libtran_depth >= __libtran_nlevels ) return;
+    l = &__libtran_levels[__libtran_depth];
+    libtran_close(l);
+    while( 0 < l->nagrees ) {
+        rc = libtran_complete(l);
+        if( 0 != rc ) libtran_rollback(l, NULL, rc);
+    }
+}
+
+static inline void libtran_raise(MPI_Comm comm, int exception)
+{
+    MPIX_Comm_revoke(comm);
+    if( 0 == exception ) exception = 1;
+    if( !__libtran_in_agree && 0 < __libtran_depth )
+        longjmp(__libtran_active[__libtran_depth-1]->jmp, exception);
+}
+
+static inline int libtran_fini(void)
+{
+    int i;
+
+    for( i = __libtran_nlevels-1; i >= 0; i-- ) {
+        if( 0 != libtran_flush_level(i) ) {
+            fprintf(stderr, "libtran: uncommitted blocks failed at level %d\n", i);
+        }
+        free(__libtran_levels[i].blocks);
+        free(__libtran_levels[i].agrees);
+    }
+    free(__libtran_levels);
+    free(__libtran_active);
+    __libtran_levels = NULL;
+    __libtran_active = NULL;
+    __libtran_nlevels = __libtran_depth = __libtran_maxdepth = 0;
+    return 0;
+}
+
+#endif  /* LIBTRAN_H */